@@ -0,0 +1,169 @@
+/*
+ * Micro-benchmarks for the per-packet path: pacer wake accuracy, transmit cost to loopback,
+ * per-packet logging, sequence stamping, CRC32C and timestamp reads.
+ * Prints one JSON object per line so that runs can be stored and compared over time.
+ * Needs no network besides the loopback interface.
+ */
+#include "constants.h"
+#include "crc32c.h"
+#include "IntervalTimer.h"
+#include "packet_log.h"
+#include "raw_packet.h"
+#include "send_path.h"
+#include "tsc_clock.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+// Times each operation benchmark is repeated, the median repetition is reported
+const int repetitions{5};
+// Payload size used for all send and stamping benchmarks
+const unsigned int bench_packet_size{64};
+// Port on the loopback interface that transmit benchmarks send to
+const unsigned int bench_port{9};
+
+/**
+ * Prevent the compiler from optimising away a value.
+ */
+template<typename T>
+inline void keep(const T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * Time an operation and print its cost per iteration.
+ * @param name Name of the benchmark.
+ * @param iterations Amount of times to run the operation per repetition.
+ * @param operation Operation to time, called with the iteration number.
+ */
+template<typename Operation>
+void bench_operation(const std::string &name, uint32_t iterations, Operation operation) {
+    std::vector<double> ns_per_op;
+    for (int repetition = 0; repetition < repetitions; repetition++) {
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < iterations; i++) {
+            operation(i);
+        }
+        const auto end = std::chrono::steady_clock::now();
+        ns_per_op.push_back(std::chrono::duration<double, std::nano>(end - start).count() / iterations);
+    }
+    std::sort(ns_per_op.begin(), ns_per_op.end());
+    std::cout << R"({"benchmark": ")" << name << R"(", "iterations": )" << iterations << R"(, "repetitions": )"
+              << repetitions << R"(, "ns_per_op_min": )" << ns_per_op.front() << R"(, "ns_per_op_median": )"
+              << ns_per_op[ns_per_op.size() / 2] << R"(, "ns_per_op_max": )" << ns_per_op.back() << "}"
+              << std::endl;
+}
+
+/**
+ * Let the pacer tick at a rate and report how late it woke up.
+ */
+void bench_pacer(double rate, double seconds, const std::string &scheduler) {
+    IntervalTimer intervalTimer{(int64_t) (S_TO_NS / rate)};
+    const auto ticks{(uint64_t) (rate * seconds)};
+    intervalTimer.start();
+    for (uint64_t tick = 0; tick < ticks; tick++) {
+        intervalTimer.await();
+    }
+    const PacerStats &stats{intervalTimer.stats()};
+    std::cout << R"({"benchmark": "pacer_wake", "rate_hz": )" << rate << R"(, "scheduler": ")" << scheduler
+              << R"(", "ticks": )" << stats.ticks.load() << R"(, "missed_deadlines": )"
+              << stats.missed_deadlines.load() << R"(, "lateness_p50_ns": )" << stats.lateness.percentile(0.5)
+              << R"(, "lateness_p90_ns": )" << stats.lateness.percentile(0.9) << R"(, "lateness_p99_ns": )"
+              << stats.lateness.percentile(0.99) << R"(, "lateness_max_ns": )" << stats.lateness.maximum() << "}"
+              << std::endl;
+}
+
+auto main() -> int {
+    std::cout << std::fixed;
+
+    // Measure the pacer the way the generator runs it
+    std::string scheduler{"SCHED_OTHER"};
+    if (geteuid() == 0) {
+        const struct sched_param schedParam = {sched_get_priority_max(SCHED_FIFO)};
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedParam) == 0) {
+            scheduler = "SCHED_FIFO";
+        }
+    }
+    for (const double rate: {1000.0, 10000.0, 100000.0}) {
+        bench_pacer(rate, 1, scheduler);
+    }
+
+    // Timestamp reads, as taken twice per send
+    bench_operation("system_clock_now", 10000000, [](uint32_t) {
+        keep(std::chrono::system_clock::now());
+    });
+    calibrate_clock();
+    bench_operation(std::string{"clock_ticks_"} + (tsc_enabled ? "tsc" : "monotonic"), 10000000, [](uint32_t) {
+        keep(clock_ticks());
+    });
+
+    // Sequence stamping, for UDP payloads and for raw datagrams with checksum patching
+    static uint8_t payload[bench_packet_size];
+    bench_operation("stamp_packet_num", 10000000, [](uint32_t i) {
+        stamp_packet_num(payload, i);
+        keep(payload);
+    });
+    // CRC trailer as stamped per packet, and over a full body as computed per pool buffer and by the verifier
+    bench_operation("crc32c_header", 10000000, [](uint32_t i) {
+        keep(crc32c_extend(i, payload, 5));
+    });
+    static uint8_t body[1472];
+    bench_operation("crc32c_1472", 1000000, [](uint32_t i) {
+        keep(crc32c_extend(i, body, sizeof(body)));
+    });
+    RawPacketTemplate raw_packet{htonl(INADDR_LOOPBACK), bench_port, htonl(INADDR_LOOPBACK), 16, 49152, 64, 0, 0,
+                                 bench_packet_size};
+    static uint8_t raw_slot[sizeof(payload) + 28];
+    raw_packet.copy_to(raw_slot);
+    bench_operation("raw_packet_prepare", 10000000, [&raw_packet](uint32_t i) {
+        raw_packet.prepare(i, raw_slot, 0);
+        keep(raw_slot);
+    });
+
+    // Transmit calls to a loopback socket that is never read, so the kernel drops once its buffer is full
+    const int receive_fd{socket(AF_INET, SOCK_DGRAM, 0)};
+    const int send_fd{socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0)};
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(bench_port);
+    if (receive_fd < 0 || send_fd < 0 || bind(receive_fd, (sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("Can't set up loopback sockets");
+        exit(errno);
+    }
+    bench_operation("sendto_loopback", 200000, [&](uint32_t) {
+        keep(sendto(send_fd, payload, sizeof(payload), 0, (sockaddr *) &addr, sizeof(addr)));
+    });
+    SendPath send_path{send_fd, addr, BackpressurePolicy::drop, 0, sizeof(payload), 0};
+    bench_operation("send_path_loopback", 200000, [&](uint32_t) {
+        send_path.send(payload, sizeof(payload));
+    });
+    close(send_fd);
+    close(receive_fd);
+
+    // Per-packet log lines, written to /dev/null so only formatting and the write calls are measured
+    std::ofstream null_stream{"/dev/null"};
+    null_stream << std::fixed;
+    const uint64_t now{clock_ticks()};
+    bench_operation("log_packet_csv", 200000, [&](uint32_t i) {
+        log_packet(null_stream, true, i, now, now);
+    });
+    bench_operation("log_packet_text", 200000, [&](uint32_t i) {
+        log_packet(null_stream, false, i, now, now);
+    });
+
+    return 0;
+}
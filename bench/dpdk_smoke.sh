@@ -0,0 +1,95 @@
+#!/usr/bin/env bash
+# Smoke test of the dpdk transport on virtual devices, needing no NIC and no hugepages. Sends on net_null and checks
+# that every packet was handed to the port, then sends on net_pcap and replays the written capture over loopback into
+# packet_generator --verify, which checks that every packet arrived with its CRC intact and none were missing.
+#
+# Usage: bench/dpdk_smoke.sh
+# Needs packet_generator_dpdk built with make dpdk. Settings are taken from the environment:
+#   DPDK_SMOKE_RATE     Rate in Hz
+#   DPDK_SMOKE_SIZE     Payload size in bytes, at least 9 to hold the CRC trailer
+#   DPDK_SMOKE_SECONDS  Length of every run in whole seconds
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+binary=$PWD/packet_generator_dpdk
+rate=${DPDK_SMOKE_RATE:-10000}
+size=${DPDK_SMOKE_SIZE:-64}
+seconds=${DPDK_SMOKE_SECONDS:-1}
+if [[ $# -gt 0 ]]; then
+    sed -n '2,/^set /{/^set /d;s/^# \{0,1\}//p}' "$0" >&2
+    exit 2
+fi
+
+if [[ ! -x $binary ]]; then
+    echo "Build packet_generator_dpdk first with make dpdk." >&2
+    exit 2
+fi
+
+# The destination is never reached, virtual devices only need the headers to be built
+dest_ip=192.0.2.1
+port=9999
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# Send on a virtual device and print how many packets the port took, failing unless it took all of them
+send() {
+    local name=$1 eal=$2
+    if ! "$binary" "$dest_ip" "$port" "$rate" "$size" 0 -q --crc -T dpdk --dpdk-eal "$eal" -t "$seconds" \
+        >"$work/$name.out" 2>&1; then
+        echo "Sending on $name failed:" >&2
+        cat "$work/$name.out" >&2
+        return 1
+    fi
+    local attempted successful
+    attempted=$(sed -n 's/^.*Attempted to send \([0-9]*\) packets, of which \([0-9]*\) .*/\1/p' "$work/$name.out")
+    successful=$(sed -n 's/^.*Attempted to send \([0-9]*\) packets, of which \([0-9]*\) .*/\2/p' "$work/$name.out")
+    if [[ -z $attempted || $attempted -eq 0 || $successful -ne $attempted ]]; then
+        echo "$name took ${successful:-no} of ${attempted:-no} packets:" >&2
+        cat "$work/$name.out" >&2
+        return 1
+    fi
+    echo "$name: sent $successful packets."
+    echo "$successful" >"$work/$name.sent"
+}
+
+# Replay a capture into the verifier and check that it received every packet intact
+verify_capture() {
+    local capture=$1 expected=$2
+    "$binary" --verify "$port" -t $((seconds + 10)) >"$work/verify.out" 2>&1 &
+    local receiver=$!
+    sleep 0.5
+    "$binary" 127.0.0.1 "$port" "$rate" "$size" 0 -q -T loopback --replay "$capture" --replay-fixed-rate \
+        >"$work/replay.out" 2>&1 || {
+        echo "Replaying $capture failed:" >&2
+        cat "$work/replay.out" >&2
+        kill "$receiver" 2>/dev/null || true
+        return 1
+    }
+    sleep 0.5
+    kill -INT "$receiver" 2>/dev/null || true
+    local status=0
+    wait "$receiver" || status=$?
+
+    local received missing
+    received=$(sed -n 's/^Total: received \([0-9]*\),.*/\1/p' "$work/verify.out")
+    missing=$(sed -n 's/^Total: .*, missing \([0-9]*\),.*/\1/p' "$work/verify.out")
+    if [[ $status -ne 0 || ${received:-0} -ne $expected || ${missing:-1} -ne 0 ]]; then
+        echo "Expected $expected intact packets from $capture, the verifier reported:" >&2
+        tail -n 1 "$work/verify.out" >&2
+        return 1
+    fi
+    echo "$capture: $received packets arrived intact."
+}
+
+failed=0
+send net_null "--no-huge --no-pci --vdev=net_null0" || failed=1
+if send net_pcap "--no-huge --no-pci --vdev=net_pcap0,tx_pcap=$work/net_pcap.pcap"; then
+    verify_capture "$work/net_pcap.pcap" "$(cat "$work/net_pcap.sent")" || failed=1
+else
+    failed=1
+fi
+
+if [[ $failed -eq 0 ]]; then
+    echo "The dpdk transport sent on net_null and net_pcap."
+fi
+exit "$failed"
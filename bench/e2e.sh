@@ -0,0 +1,165 @@
+#!/usr/bin/env bash
+# End-to-end performance regression harness. For every combination of rate and size, sends from the host over a veth
+# pair into a network namespace running packet_generator --verify, and compares the achieved rate, loss,
+# inter-departure jitter and CPU time per packet with a stored baseline, failing on regressions beyond the tolerances.
+#
+# Usage: bench/e2e.sh [--record]
+#   --record  Write the results as the new baseline instead of comparing with it. Baselines only hold for the machine
+#             they were recorded on.
+# Needs root to create the namespace, and packet_generator built. Settings are taken from the environment:
+#   E2E_RATES             Space separated rates in Hz
+#   E2E_SIZES             Space separated payload sizes in bytes, at least 9 to hold the CRC trailer
+#   E2E_SECONDS           Length of every run in whole seconds
+#   E2E_BASELINE          Baseline file
+#   E2E_RATE_TOLERANCE    Fraction the achieved rate may fall below the baseline
+#   E2E_LOSS_TOLERANCE    Percentage points the loss may rise above the baseline
+#   E2E_JITTER_TOLERANCE  Fraction the inter-departure standard deviation may rise above the baseline
+#   E2E_CPU_TOLERANCE     Fraction the CPU time per packet may rise above the baseline
+#   E2E_SENDER_ARGS       Extra arguments for every sender, for example --cpus to pin it
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+binary=$PWD/packet_generator
+rates=${E2E_RATES:-"10000 50000 100000"}
+sizes=${E2E_SIZES:-"64 512 1400"}
+seconds=${E2E_SECONDS:-3}
+baseline=${E2E_BASELINE:-bench/e2e_baseline.csv}
+rate_tolerance=${E2E_RATE_TOLERANCE:-0.02}
+loss_tolerance=${E2E_LOSS_TOLERANCE:-0.5}
+jitter_tolerance=${E2E_JITTER_TOLERANCE:-0.5}
+cpu_tolerance=${E2E_CPU_TOLERANCE:-0.25}
+sender_args=${E2E_SENDER_ARGS:-}
+record=0
+if [[ ${1:-} == --record ]]; then
+    record=1
+elif [[ $# -gt 0 ]]; then
+    sed -n '2,/^set /{/^set /d;s/^# \{0,1\}//p}' "$0" >&2
+    exit 2
+fi
+
+if [[ $EUID -ne 0 ]]; then
+    echo "The harness creates a network namespace and needs root." >&2
+    exit 2
+fi
+if [[ ! -x $binary ]]; then
+    echo "Build packet_generator first with make." >&2
+    exit 2
+fi
+if [[ $record -eq 0 && ! -f $baseline ]]; then
+    echo "No baseline at $baseline, record one on this machine first with $0 --record." >&2
+    exit 2
+fi
+
+# Named after this process, so that concurrent runs don't collide. Interface names are limited to 15 characters.
+namespace=pg_e2e_$$
+host_veth=pge$$h
+peer_veth=pge$$n
+host_ip=10.201.0.1
+peer_ip=10.201.0.2
+port=9999
+work=$(mktemp -d)
+
+cleanup() {
+    ip netns del "$namespace" 2>/dev/null || true
+    ip link del "$host_veth" 2>/dev/null || true
+    rm -rf "$work"
+}
+trap cleanup EXIT
+
+ip netns add "$namespace"
+ip link add "$host_veth" type veth peer name "$peer_veth"
+ip link set "$peer_veth" netns "$namespace"
+ip addr add "$host_ip/30" dev "$host_veth"
+ip link set "$host_veth" up
+ip -n "$namespace" addr add "$peer_ip/30" dev "$peer_veth"
+ip -n "$namespace" link set "$peer_veth" up
+ip -n "$namespace" link set lo up
+
+results=$work/results.csv
+echo "rate_hz, size_bytes, achieved_hz, loss_pct, jitter_us, cpu_ns_per_packet" >"$results"
+failed=0
+
+# Run one combination, appending its row to the results
+run() {
+    local rate=$1 size=$2
+    ip netns exec "$namespace" "$binary" --verify "$port" --arrivals "$work/arrivals.csv" -t $((seconds + 5)) \
+        >"$work/verify.out" &
+    local receiver=$!
+    sleep 0.5
+
+    local TIMEFORMAT='%U %S'
+    # shellcheck disable=SC2086 # Extra arguments are split on purpose
+    { time "$binary" "$peer_ip" "$port" "$rate" "$size" 0 -c --crc -t "$seconds" -i "$host_veth" $sender_args \
+        >"$work/departures.csv" 2>"$work/sender.err"; } 2>"$work/cpu" || {
+        echo "Sender failed at ${rate}Hz, ${size}B:" >&2
+        cat "$work/sender.err" >&2
+        failed=1
+    }
+    sleep 0.5
+    kill -INT "$receiver" 2>/dev/null || true
+    if ! wait "$receiver"; then
+        echo "Receiver found corrupted packets at ${rate}Hz, ${size}B:" >&2
+        tail -n 1 "$work/verify.out" >&2
+        failed=1
+    fi
+
+    "$binary" --analyze "$work/departures.csv" --arrivals "$work/arrivals.csv" >"$work/analysis"
+    local packets achieved loss jitter
+    packets=$(sed -n 's/^Sender trace: \([0-9]*\) packets.*/\1/p' "$work/analysis")
+    achieved=$(sed -n 's/^Sender trace: .*, \([0-9.]*\)Hz on average.*/\1/p' "$work/analysis")
+    loss=$(sed -n 's/^Arrival trace: .*, [0-9]* (\([0-9.]*\)%) were lost.*/\1/p' "$work/analysis")
+    jitter=$(sed -n 's/^Inter-departure jitter: .*standard deviation \([0-9.]*\)us\./\1/p' "$work/analysis")
+    # Includes the sender's setup, which is small next to a run of several seconds
+    awk -v rate="$rate" -v size="$size" -v achieved="$achieved" -v loss="$loss" -v jitter="$jitter" \
+        -v packets="$packets" '{ printf "%s, %s, %.1f, %.3f, %.3f, %.1f\n", rate, size, achieved, loss, jitter,
+                                 ($1 + $2) * 1e9 / packets }' "$work/cpu" >>"$results"
+    tail -n 1 "$results"
+}
+
+for rate in $rates; do
+    for size in $sizes; do
+        run "$rate" "$size"
+    done
+done
+
+if [[ $record -eq 1 ]]; then
+    cp "$results" "$baseline"
+    echo "Recorded baseline $baseline."
+    exit "$failed"
+fi
+
+# Compare every row with the baseline row of the same rate and size
+awk -F', *' -v rate_tolerance="$rate_tolerance" -v loss_tolerance="$loss_tolerance" \
+    -v jitter_tolerance="$jitter_tolerance" -v cpu_tolerance="$cpu_tolerance" '
+    function check(name, value, limit, worse_when_higher) {
+        if (worse_when_higher ? value > limit : value < limit) {
+            printf "REGRESSION at %sHz, %sB: %s %s, limit %s\n", $1, $2, name, value, limit
+            regressed = 1
+        }
+    }
+    NR == FNR {
+        if (FNR > 1) {
+            baseline[$1 "," $2] = $0
+        }
+        next
+    }
+    FNR > 1 {
+        if (!(($1 "," $2) in baseline)) {
+            printf "No baseline for %sHz, %sB, record a new one.\n", $1, $2
+            regressed = 1
+            next
+        }
+        split(baseline[$1 "," $2], base, ", *")
+        check("achieved rate", $3, base[3] * (1 - rate_tolerance), 0)
+        check("loss", $4, base[4] + loss_tolerance, 1)
+        check("jitter", $5, base[5] * (1 + jitter_tolerance), 1)
+        check("CPU per packet", $6, base[6] * (1 + cpu_tolerance), 1)
+    }
+    END {
+        exit regressed
+    }' "$baseline" "$results" || failed=1
+
+if [[ $failed -eq 0 ]]; then
+    echo "No regressions against $baseline."
+fi
+exit "$failed"
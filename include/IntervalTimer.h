@@ -1,55 +1,228 @@
 #ifndef PACKET_GENERATOR_INTERVALTIMER_H
 #define PACKET_GENERATOR_INTERVALTIMER_H
 
-#include <csignal>
-#include <sys/time.h>
+#include "constants.h"
+#include "histogram.h"
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+/**
+ * Longest interval a timer accepts, about 32 years, which keeps deadlines on any clock far from overflowing.
+ */
+const int64_t MAX_INTERVAL_NS{S_TO_NS * S_TO_NS};
+
+/**
+ * What to do when a deadline has already passed by more than one interval once the sender gets to it.
+ */
+enum class OverrunPolicy {
+    /**
+     * Send all missed packets at once, keeping the average rate.
+     */
+    burst,
+    /**
+     * Drop the missed ticks, keeping the phase of later deadlines.
+     */
+    skip,
+    /**
+     * Restart the interval from the moment the sender caught up, shifting all later deadlines.
+     */
+    stretch,
+};
+
+/**
+ * Parse an overrun policy from its name.
+ * @param name One of "burst", "skip" or "stretch".
+ * @return Parsed policy. Exits on unknown names.
+ */
+auto parse_overrun_policy(const std::string &name) -> OverrunPolicy;
+
+/**
+ * Counters kept by the timer.
+ * Only the timer writes them, other threads may read them at any time.
+ */
+struct PacerStats {
+    /**
+     * Deadlines that were waited for.
+     */
+    std::atomic<uint64_t> ticks{0};
+    /**
+     * Deadlines that had already passed by a full interval or more when they were waited for.
+     */
+    std::atomic<uint64_t> missed_deadlines{0};
+    /**
+     * Ticks that were never sent, under the skip policy or when a burst was capped.
+     */
+    std::atomic<uint64_t> skipped_ticks{0};
+    /**
+     * Extra packets sent to catch up under the burst policy.
+     */
+    std::atomic<uint64_t> burst_packets{0};
+    /**
+     * Time between each deadline and the moment the timer returned.
+     */
+    LatenessHistogram lateness{};
+};
 
 /**
  * Timer that will unlock at a specific interval.
- * Causes an uncaught SIGALRM signal if the timer unlocks and no-one is waiting.
+ * Deadlines lie on a fixed grid, so late wakeups do not accumulate into drift. By default the grid starts shortly
+ * after start() on CLOCK_MONOTONIC; align() anchors it to an absolute time on CLOCK_REALTIME or CLOCK_TAI instead,
+ * so that timers in separate processes or on separate hosts unlock in a known phase relation.
  */
 class IntervalTimer {
 private:
     /**
-     * Stores the interval to wait for.
+     * Stores the interval to wait for in nanoseconds.
+     */
+    int64_t interval_ns;
+    /**
+     * Stores the time until the first unlock after start() in nanoseconds.
+     */
+    int64_t first_unlock_ns;
+    /**
+     * Clock the deadlines are on.
      */
-    struct itimerval interval{{0, 0},
-                              {0, 0}};
+    clockid_t clock{CLOCK_MONOTONIC};
     /**
-     * Stores the signal to wait for.
+     * Whether deadlines lie on the grid through grid_origin_ns, rather than on a grid starting at start().
      */
-    sigset_t alarm_signal{};
+    bool aligned{false};
     /**
-     * Stores the signal number that triggered an unlock.
+     * Time on the clock in nanoseconds that a deadline falls on when aligned.
      */
-    int signum{0};
+    int64_t grid_origin_ns{0};
+    /**
+     * Stores the next deadline in nanoseconds on the clock.
+     */
+    int64_t next_deadline_ns{0};
+    /**
+     * First deadline after start(), which await_offset() measures from.
+     */
+    int64_t start_ns{0};
+    /**
+     * Nanoseconds before a deadline to stop sleeping and spin on the tick clock instead, 0 to only sleep.
+     */
+    int64_t spin_ns{0};
+    OverrunPolicy overrun_policy;
+    /**
+     * Highest amount of packets to release in one burst, 0 for unlimited.
+     */
+    uint32_t max_burst;
+    PacerStats pacer_stats{};
+
+    /**
+     * Increment a counter that only the timer writes.
+     */
+    static void bump(std::atomic<uint64_t> &counter, uint64_t amount = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    /**
+     * Wait until a time on the clock, sleeping and then spinning for the last spin_ns.
+     * @tparam spinning Whether spin_ns is set, so that only sleeping takes no check for it.
+     * @param deadline_ns Time on the clock in nanoseconds.
+     * @return 0, or EINTR if the wait was interrupted.
+     */
+    template<bool spinning>
+    auto wait_until(int64_t deadline_ns) const -> int;
 
 public:
     /**
      * Create an IntervalTimer, but do not start it.
-     * @param seconds Seconds in each interval.
-     * @param microseconds Microseconds in each interval.
-     * @param first_unlock_us Time until the first unlock in microseconds. Default 1000.
+     * @param interval_ns Nanoseconds in each interval, from 1 up to MAX_INTERVAL_NS. Exits on others.
+     * @param overrun_policy What to do with deadlines that passed while the sender was busy.
+     * @param max_burst Highest amount of packets to release at once under the burst policy, 0 for unlimited.
+     * @param first_unlock_ns Time until the first unlock in nanoseconds. Default 1 millisecond.
      */
-    IntervalTimer(long seconds, long microseconds, long first_unlock_us = 1000);
+    explicit IntervalTimer(int64_t interval_ns, OverrunPolicy overrun_policy = OverrunPolicy::skip,
+                           uint32_t max_burst = 0, int64_t first_unlock_ns = 1000000);
+
+    /**
+     * Anchor deadlines to an absolute grid: grid_origin_ns plus any whole number of intervals.
+     * Takes effect on the next start().
+     * @param clock CLOCK_REALTIME, or CLOCK_TAI to be immune to leap seconds.
+     * @param grid_origin_ns Time on the clock in nanoseconds that a deadline falls on.
+     */
+    void align(clockid_t clock, int64_t grid_origin_ns);
 
     /**
      * Start the timer.
-     * First unlock will happen in 1000 microseconds.
+     * First unlock will happen after first_unlock_ns, or when aligned, on the first grid point at least that far
+     * away, which is the grid origin itself if it lies far enough in the future.
      * Can be used to resume a previously stopped timer.
      */
     void start();
 
     /**
-     * Stop the timer.
+     * Blocking call that waits until the next time the timer unlocks.
+     * @return Amount of packets to send for this unlock, which is 0 if the wait was interrupted by a signal.
      */
-    static void stop();
+    auto await() -> uint32_t;
 
     /**
-     * Blocking call that waits until the next time the timer unlocks.
+     * await(), specialised for send loops that must not branch on tracing or spinning at every deadline.
+     * Missed deadlines still go through the overrun policy at runtime, they are off the path of a timer that keeps up.
+     * @tparam traced Whether to record trace events, if tracing is on.
+     * @tparam spinning Whether spinning() is true.
+     * @return Amount of packets to send for this unlock, which is 0 if the wait was interrupted by a signal.
+     */
+    template<bool traced, bool spinning>
+    auto await() -> uint32_t;
+
+    /**
+     * Blocking call that waits until a time relative to the first deadline after start(), for schedules that are
+     * not a fixed grid, such as the gaps of a replayed capture.
+     * A deadline that has already passed is missed and returns at once under the burst and skip policies; under
+     * stretch, it shifts all later deadlines by the lateness instead.
+     * @param offset_ns Nanoseconds after the first deadline.
+     * @return False if the wait was interrupted by a signal.
+     */
+    auto await_offset(int64_t offset_ns) -> bool;
+
+    /**
+     * Spin rather than sleep for the end of every wait, which avoids the wakeup latency of the scheduler at the
+     * cost of keeping a CPU busy.
+     * @param new_spin_ns Nanoseconds before each deadline to start spinning, 0 to only sleep, or INT64_MAX to never
+     * sleep.
+     */
+    void set_spin(int64_t new_spin_ns) {
+        spin_ns = new_spin_ns;
+    }
+
+    /**
+     * @return Whether the end of every wait spins.
+     */
+    [[nodiscard]] auto spinning() const -> bool {
+        return spin_ns != 0;
+    }
+
+    /**
+     * Change the interval from the next unlock on.
+     * The pending deadline moves so that it lies one new interval after the last unlock.
+     * @param new_interval_ns Nanoseconds in each interval, from 1 up to MAX_INTERVAL_NS. Exits on others.
+     */
+    void set_interval(int64_t new_interval_ns);
+
+    /**
+     * @return Interval between unlocks in nanoseconds.
+     */
+    [[nodiscard]] auto interval() const -> int64_t {
+        return interval_ns;
+    }
+
+    /**
+     * Reset all counters to zero. Must only be called from the thread awaiting the timer.
+     */
+    void reset_stats();
+
+    /**
+     * @return Counters kept so far.
      */
-    void await() {
-        sigwait(&alarm_signal, &signum);
+    [[nodiscard]] auto stats() const -> const PacerStats & {
+        return pacer_stats;
     }
 };
 
@@ -0,0 +1,15 @@
+#ifndef PACKET_GENERATOR_ANALYZER_H
+#define PACKET_GENERATOR_ANALYZER_H
+
+/**
+ * Entry point of packet_generator --analyze, which post-processes a sender trace written with --csv, and optionally
+ * an arrival trace written by packet_generator --verify --arrivals, on all cores.
+ * Prints the inter-departure time distribution, the rate over time, gaps and bursts in the departures, and when
+ * arrivals are given, loss and the one-way delay of every packet joined by label and sequence number.
+ * @param argc Amount of command line arguments.
+ * @param argv Command line arguments, starting with --analyze.
+ * @return Exit code.
+ */
+auto analyze_main(int argc, char *argv[]) -> int; // NOLINT(modernize-avoid-c-arrays) // Disabled as argv has to be of dynamic length
+
+#endif //PACKET_GENERATOR_ANALYZER_H
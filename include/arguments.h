@@ -0,0 +1,89 @@
+#ifndef PACKET_GENERATOR_ARGUMENTS_H
+#define PACKET_GENERATOR_ARGUMENTS_H
+
+#include "IntervalTimer.h"
+#include "payload.h"
+#include "send_path.h"
+#include "transport.h"
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+/**
+ * Settings for a generator run, as parsed from the command line.
+ */
+struct arguments {
+    std::string dest_ip;
+    unsigned int dest_port;
+    double packet_freq;
+    unsigned int packet_size;
+    uint8_t packet_dscp;
+    unsigned int timeout;
+    bool verbose;
+    std::string interface;
+    uint8_t label_byte;
+    bool csv;
+    bool raw;
+    std::string src_ip;
+    unsigned int src_ip_count;
+    unsigned int src_port;
+    unsigned int src_port_count;
+    BackpressurePolicy backpressure;
+    unsigned int retry_queue_size;
+    unsigned int block_deadline_us;
+    OverrunPolicy overrun;
+    unsigned int max_burst;
+    bool quiet;
+    std::vector<unsigned int> benchmark_sizes;
+    unsigned int trial_length;
+    double tolerance;
+    double loss_ratio;
+    TransportType transport;
+    std::string pcap_file;
+    bool perf;
+    bool shm;
+    std::string shm_name;
+    std::string control;
+    bool aligned;
+    int64_t start_at_ns;
+    int64_t phase_offset_ns;
+    clockid_t clock;
+    unsigned int instances;
+    std::vector<unsigned int> cpus;
+    std::vector<std::string> interfaces;
+    bool rt;
+    double warmup_s;
+    bool warmup_probes;
+    std::string trace;
+    unsigned int trace_events;
+    std::string replay;
+    double replay_speed;
+    bool replay_fixed_rate;
+    PayloadMode payload_mode;
+    uint64_t payload_seed;
+    std::string payload_file;
+    unsigned int payload_pool;
+    bool crc;
+    std::string tcp_file;
+    double pacing_rate_mbps;
+    int64_t spin_ns;
+    std::string dpdk_eal_args;
+    uint16_t dpdk_port;
+    std::string dpdk_dest_mac;
+    unsigned int queue_sample_ms;
+    std::string queue_log;
+};
+
+/**
+ * Parse the command line into a set of arguments.
+ * Prints usage and exits on invalid input.
+ * @param argc Amount of command line arguments.
+ * @param argv Command line arguments.
+ * @return Parsed arguments.
+ */
+auto parse_args(int argc,
+                char *argv[]) -> struct arguments; // NOLINT(modernize-avoid-c-arrays) // Disabled as argv has to be of dynamic length
+
+#endif //PACKET_GENERATOR_ARGUMENTS_H
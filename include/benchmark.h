@@ -0,0 +1,14 @@
+#ifndef PACKET_GENERATOR_BENCHMARK_H
+#define PACKET_GENERATOR_BENCHMARK_H
+
+#include "arguments.h"
+
+/**
+ * Search for the highest rate at which each configured packet size is sent without loss, in the style of RFC 2544.
+ * Loss is measured end-to-end by a receiver on the local host, listening on the destination port.
+ * Prints a table of the rate, throughput, loss and latency found for each packet size.
+ * @param args Arguments to take the packet sizes, highest rate and search settings from.
+ */
+void run_benchmark(const struct arguments &args);
+
+#endif //PACKET_GENERATOR_BENCHMARK_H
@@ -0,0 +1,52 @@
+#ifndef PACKET_GENERATOR_CHECKSUM_H
+#define PACKET_GENERATOR_CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Add the contents of a buffer to a running Internet checksum (RFC 1071).
+ * Words are summed in host byte order, which yields the checksum in network byte order once folded and stored as-is.
+ * Accumulates 32-bit words into a 64-bit sum so the main loop vectorizes.
+ * @param sum Running sum to add to.
+ * @param data Buffer to sum.
+ * @param length Length of the buffer in bytes. Only the final call for a buffer may have an odd length.
+ * @return New running sum, not yet folded.
+ */
+inline auto checksum_add(uint64_t sum, const void *data, size_t length) -> uint64_t {
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    size_t i{0};
+    for (; i + 4 <= length; i += 4) {
+        uint32_t word;
+        std::memcpy(&word, bytes + i, 4);
+        sum += word;
+    }
+    if (i + 2 <= length) {
+        uint16_t word;
+        std::memcpy(&word, bytes + i, 2);
+        sum += word;
+        i += 2;
+    }
+    if (i < length) {
+        // Trailing byte is the high-order byte of a zero-padded word
+        uint16_t word{0};
+        std::memcpy(&word, bytes + i, 1);
+        sum += word;
+    }
+    return sum;
+}
+
+/**
+ * Fold a running sum into the final 16-bit Internet checksum.
+ * @param sum Running sum as returned by checksum_add.
+ * @return One's complement of the folded sum, ready to be stored in a header.
+ */
+inline auto checksum_finish(uint64_t sum) -> uint16_t {
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (uint16_t) ~sum;
+}
+
+#endif //PACKET_GENERATOR_CHECKSUM_H
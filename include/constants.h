@@ -6,4 +6,19 @@ enum {
     S_TO_US = (1000000),
 };
 
+// Amount of nanoseconds in a second
+enum : long {
+    S_TO_NS = (1000000000L),
+};
+
+// Bytes the IPv4 and UDP headers add to each payload
+enum {
+    IP_UDP_HEADER_BYTES = (28),
+};
+
+// Largest UDP payload an IPv4 packet can carry
+enum {
+    MAX_UDP_PAYLOAD_BYTES = (65507),
+};
+
 #endif //PACKET_GENERATOR_CONSTANTS_H
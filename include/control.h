@@ -0,0 +1,108 @@
+#ifndef PACKET_GENERATOR_CONTROL_H
+#define PACKET_GENERATOR_CONTROL_H
+
+#include "event_loop.h"
+#include "live_stats.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Settings that can be changed while the generator runs.
+ */
+struct RuntimeSettings {
+    double packet_freq;
+    unsigned int packet_size;
+    /**
+     * DSCP shifted into the ToS byte, as in the arguments.
+     */
+    uint8_t packet_dscp;
+    bool paused;
+};
+
+/**
+ * Serves a line-based control protocol on a UNIX stream socket from an event loop.
+ * Commands, one per line, each answered with a single line:
+ *   set [rate=<Hz>] [size=<bytes>] [dscp=<code>]   change settings together, answers "ok"
+ *   pause, resume                                   stop and restart sending, answers "ok"
+ *   get                                             answers the current settings as key=value pairs
+ *   stats                                           answers the live counters as key=value pairs
+ * Invalid commands are answered with "error: <reason>".
+ * Changes are collected here and taken by the sending thread at its next deadline, so they apply atomically.
+ */
+class ControlServer {
+private:
+    EventLoop &loop;
+    std::string path;
+    int listen_fd{-1};
+    const LiveStatsSegment &live_stats;
+    std::mutex mutex;
+    std::condition_variable resumed;
+    RuntimeSettings pending;
+    std::atomic<bool> changed{false};
+    /**
+     * Connected clients and the partial line received from each.
+     */
+    std::unordered_map<int, std::string> clients;
+
+    void accept_clients();
+
+    void serve_client(int client_fd);
+
+    void disconnect(int client_fd);
+
+    /**
+     * Run a single command.
+     * @return Reply, without the line ending.
+     */
+    auto execute(const std::string &line) -> std::string;
+
+public:
+    /**
+     * Listen on a socket, replacing a stale socket file at the path.
+     * @param loop Event loop to serve clients on, not yet started.
+     * @param path Path of the socket.
+     * @param initial Settings the generator starts with.
+     * @param live_stats Segment to answer stats queries from.
+     */
+    ControlServer(EventLoop &loop, std::string path, const RuntimeSettings &initial,
+                  const LiveStatsSegment &live_stats);
+
+    ControlServer(const ControlServer &) = delete;
+
+    auto operator=(const ControlServer &) -> ControlServer & = delete;
+
+    /**
+     * Disconnect all clients and remove the socket. The event loop must be stopped first.
+     */
+    ~ControlServer();
+
+    /**
+     * @return Whether settings changed since the sending thread last took them.
+     */
+    [[nodiscard]] auto has_changes() const -> bool {
+        return changed.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @return Settings to apply from now on.
+     */
+    auto take_changes() -> RuntimeSettings;
+
+    /**
+     * Block the sending thread while paused.
+     * @return False if the wait ended because of a keyboard interrupt.
+     */
+    auto wait_resumed() -> bool;
+
+    /**
+     * Wake the sending thread from wait_resumed() after a keyboard interrupt.
+     */
+    void interrupt();
+};
+
+#endif //PACKET_GENERATOR_CONTROL_H
@@ -0,0 +1,24 @@
+#ifndef PACKET_GENERATOR_CRC32C_H
+#define PACKET_GENERATOR_CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Extend a running CRC32C (Castagnoli) over a buffer.
+ * Uses the SSE4.2 crc32 instruction where the CPU has it and a lookup table otherwise.
+ * @param state Running state, ~0 to start a new CRC.
+ * @param data Buffer to add.
+ * @param length Length of the buffer in bytes.
+ * @return New running state, which is the CRC once inverted.
+ */
+auto crc32c_extend(uint32_t state, const void *data, size_t length) -> uint32_t;
+
+/**
+ * @return CRC32C of a buffer.
+ */
+inline auto crc32c(const void *data, size_t length) -> uint32_t {
+    return ~crc32c_extend(~0U, data, length);
+}
+
+#endif //PACKET_GENERATOR_CRC32C_H
@@ -0,0 +1,56 @@
+#ifndef PACKET_GENERATOR_DPDK_TRANSPORT_H
+#define PACKET_GENERATOR_DPDK_TRANSPORT_H
+
+#include "transport.h"
+
+#include <cstddef>
+#include <cstdint>
+
+struct arguments;
+struct rte_mempool;
+
+/**
+ * Transmits packets as Ethernet frames on a DPDK port in poll mode, bypassing the kernel entirely.
+ * Frames are built in mbufs whose Ethernet header was written once up front, and transmitted a batch at a time with
+ * rte_eth_tx_burst. Packets too large for an mbuf are dropped. Only part of builds made with make dpdk, which can be
+ * tested without a NIC on the net_null and net_pcap virtual devices.
+ */
+class DpdkTransport final : public Transport {
+private:
+    uint16_t port;
+    rte_mempool *mbuf_pool{nullptr};
+    /**
+     * Longest frame an mbuf holds, including the Ethernet header.
+     */
+    size_t max_frame_bytes{0};
+    SendStats send_stats{};
+
+public:
+    /**
+     * Initialise DPDK if needed, then configure and start a single transmit queue on the port.
+     * @param args Arguments to take the EAL arguments, port and destination MAC address from.
+     */
+    explicit DpdkTransport(const struct arguments &args);
+
+    DpdkTransport(const DpdkTransport &) = delete;
+
+    auto operator=(const DpdkTransport &) -> DpdkTransport & = delete;
+
+    ~DpdkTransport() override;
+
+    void send_batch(const OutgoingPacket *packets, size_t count) override;
+
+    void reset_stats() override {
+        send_stats = SendStats{};
+    }
+
+    [[nodiscard]] auto stats() const -> const SendStats & override {
+        return send_stats;
+    }
+
+    [[nodiscard]] auto needs_ip_headers() const -> bool override {
+        return true;
+    }
+};
+
+#endif //PACKET_GENERATOR_DPDK_TRANSPORT_H
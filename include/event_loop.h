@@ -0,0 +1,65 @@
+#ifndef PACKET_GENERATOR_EVENT_LOOP_H
+#define PACKET_GENERATOR_EVENT_LOOP_H
+
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * Serves file descriptors from an epoll instance on a background thread, away from the pacing thread.
+ * Handlers run on the loop's thread. Watching and unwatching is only allowed before start() or from a handler.
+ */
+class EventLoop {
+private:
+    int epoll_fd{-1};
+    /**
+     * eventfd that wakes the loop to stop it.
+     */
+    int stop_fd{-1};
+    std::thread thread;
+    std::unordered_map<int, std::function<void(uint32_t)>> handlers;
+
+    /**
+     * Dispatch events until stopped.
+     */
+    void run();
+
+public:
+    EventLoop();
+
+    EventLoop(const EventLoop &) = delete;
+
+    auto operator=(const EventLoop &) -> EventLoop & = delete;
+
+    /**
+     * Stop the loop and close the epoll instance. Watched file descriptors are left open.
+     */
+    ~EventLoop();
+
+    /**
+     * Call a handler whenever a file descriptor becomes ready.
+     * @param fd File descriptor to watch.
+     * @param events epoll events to wait for.
+     * @param handler Called with the events that occurred.
+     */
+    void watch(int fd, uint32_t events, std::function<void(uint32_t)> handler);
+
+    /**
+     * Stop watching a file descriptor, before it is closed.
+     * @param fd File descriptor to stop watching.
+     */
+    void unwatch(int fd);
+
+    /**
+     * Start dispatching on a background thread.
+     */
+    void start();
+
+    /**
+     * Stop dispatching and wait for the background thread to finish.
+     */
+    void stop();
+};
+
+#endif //PACKET_GENERATOR_EVENT_LOOP_H
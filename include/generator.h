@@ -0,0 +1,161 @@
+#ifndef PACKET_GENERATOR_GENERATOR_H
+#define PACKET_GENERATOR_GENERATOR_H
+
+#include "arguments.h"
+#include "IntervalTimer.h"
+#include "live_stats.h"
+#include "send_path.h"
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Outcome of a warm-up phase.
+ */
+struct WarmupStats {
+    std::chrono::duration<double, std::micro> duration;
+    /**
+     * Probe packets sent, all with sequence number 0.
+     */
+    uint64_t probes;
+    /**
+     * Windows over which lateness was compared.
+     */
+    unsigned int windows;
+    /**
+     * Whether lateness settled before the warm-up time ran out.
+     */
+    bool settled;
+    /**
+     * 99th percentile wake lateness of the first and last window in nanoseconds.
+     */
+    uint64_t first_p99_ns;
+    uint64_t last_p99_ns;
+    /**
+     * Wake lateness over the whole warm-up in nanoseconds.
+     */
+    uint64_t median_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+};
+
+/**
+ * Open the configured transport and build the packet contents for the configured packet size.
+ * May be called again to switch to a different packet size.
+ * @param args Arguments to take the transport, destination and packet layout from.
+ */
+void open_transport(const struct arguments &args);
+
+/**
+ * Close the transport and free all packet buffers.
+ */
+void close_transport();
+
+/**
+ * Start the event loop serving signals, the control socket and queue sampling, then switch to the SCHED_FIFO
+ * scheduler when running as root. With the RT profile, also pin the sending thread and lock and prefault memory.
+ * When the interface's device reports a NUMA node, memory is allocated from that node and the sending thread is kept
+ * on its CPUs unless pinned with --cpus, which is reported if it is on another node.
+ * Must be called on the sending thread before any other thread is started, and before the transport is opened.
+ * @param args Arguments to take the verbosity, RT profile, live statistics, control socket and queue sampling
+ * settings from.
+ */
+void enable_realtime(const struct arguments &args);
+
+/**
+ * Publish live statistics in a segment mapped by another process. Must be called before enable_realtime().
+ * @param segment Segment to publish in.
+ */
+void publish_live_stats_in(LiveStatsSegment *segment);
+
+/**
+ * Stop dispatching events, keeping the control socket and the queue sampler for reporting. The event loop's thread
+ * is traced, so this must come before writing the trace.
+ */
+void halt_event_loop();
+
+/**
+ * Stop the event loop, then close the control socket and the queue sampler. Also runs at exit.
+ */
+void stop_event_loop();
+
+/**
+ * @param packet_freq Frequency in Hz to send packets at.
+ * @return Interval between packets in nanoseconds.
+ */
+auto interval_for(double packet_freq) -> int64_t;
+
+/**
+ * Record the send time of every stride-th packet, for latency measurements.
+ * @param send_times_ticks Buffer to write send times in clock ticks to, or nullptr to stop recording.
+ * @param capacity Amount of send times the buffer holds.
+ * @param stride Record packets whose sequence number is a multiple of this.
+ */
+void record_send_times(int64_t *send_times_ticks, uint32_t capacity, uint32_t stride);
+
+/**
+ * Send packets on the timer until the timeout passes or the user interrupts.
+ * Sequence numbers and send counters start from zero on every call.
+ * @param args Arguments to take the timeout and output format from.
+ * @param intervalTimer Timer to pace packets with, not yet started.
+ * @return Time spent sending.
+ */
+auto run_generator(const struct arguments &args,
+                   IntervalTimer &intervalTimer) -> std::chrono::duration<double, std::micro>;
+
+/**
+ * Resend the UDP payloads of the capture in the arguments until it ends, the timeout passes or the user interrupts.
+ * Payloads are sent at their captured gaps divided by the replay speed, or one per tick at a fixed rate, with the same
+ * counters as run_generator.
+ * @param args Arguments to take the capture, its timing, the timeout and output format from.
+ * @param intervalTimer Timer to pace packets with, not yet started.
+ * @return Time spent sending.
+ */
+auto run_replay(const struct arguments &args,
+                IntervalTimer &intervalTimer) -> std::chrono::duration<double, std::micro>;
+
+/**
+ * Connect to the destination over TCP and stream data until the timeout passes or the user interrupts.
+ * Replaces open_transport(); report_stats() then reports the stream's goodput, retransmits and RTT.
+ * @param args Arguments to take the destination, stream settings and timeout from.
+ * @return Time spent sending.
+ */
+auto run_tcp_stream(const struct arguments &args) -> std::chrono::duration<double, std::micro>;
+
+/**
+ * Run the timer until wake lateness settles or the warm-up time runs out, without counting anything towards the
+ * following run. Lateness has settled once the 99th percentile of consecutive windows stays within a histogram bucket.
+ * Optionally sends probe packets with sequence number 0, so that receivers can discard them, to also warm up caches,
+ * neighbour resolution and the socket.
+ * @param args Arguments to take the warm-up settings and rate from.
+ * @param intervalTimer Timer to pace with, not yet started. Its counters are reset afterwards.
+ * @return Outcome of the warm-up.
+ */
+auto run_warmup(const struct arguments &args, IntervalTimer &intervalTimer) -> WarmupStats;
+
+/**
+ * Print the outcome of a warm-up, before the statistics of the run that followed.
+ * @param warmup Outcome of the warm-up.
+ */
+void report_warmup(const WarmupStats &warmup);
+
+/**
+ * @return Amount of packets the last run attempted to send.
+ */
+auto attempted_packets() -> uint32_t;
+
+/**
+ * @return Counters the send path kept during the last run.
+ */
+auto send_stats() -> const SendStats &;
+
+/**
+ * Print statistics about a run, and exit if less than 95% of the packets were sent successfully.
+ * With --sample-queues, also summarises which kernel queues were full while sends failed.
+ * After run_tcp_stream(), prints the stream's goodput, retransmits and RTT instead.
+ * @param duration Time spent sending.
+ * @param pacer_stats Counters kept by the timer during the run.
+ */
+void report_stats(std::chrono::duration<double, std::micro> duration, const PacerStats &pacer_stats);
+
+#endif //PACKET_GENERATOR_GENERATOR_H
@@ -0,0 +1,103 @@
+#ifndef PACKET_GENERATOR_HISTOGRAM_H
+#define PACKET_GENERATOR_HISTOGRAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Log-linear histogram of durations in nanoseconds.
+ * Every power of two is split into four buckets, so values are kept to within 25%.
+ * Written by a single thread with plain stores, so other threads can read it at any time without locking.
+ */
+class LatenessHistogram {
+public:
+    /**
+     * Amount of buckets needed to cover all 64-bit values.
+     */
+    static constexpr size_t BUCKETS{252};
+
+private:
+    std::atomic<uint64_t> counts[BUCKETS]{};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> max{0};
+
+public:
+    /**
+     * @return Index of the bucket a value falls in.
+     */
+    static auto bucket_of(uint64_t value_ns) -> size_t;
+
+    /**
+     * @return Highest value that falls in a bucket.
+     */
+    static auto bucket_upper_bound(size_t bucket) -> uint64_t;
+
+    /**
+     * Record a value. Must only be called from a single thread.
+     */
+    void record(uint64_t value_ns) {
+        std::atomic<uint64_t> &count{counts[bucket_of(value_ns)]};
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        total.store(total.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (value_ns > max.load(std::memory_order_relaxed)) {
+            max.store(value_ns, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Add values counted by another histogram, to combine the histograms of several generators.
+     * Does not change the maximum, see merge_maximum(). Must only be called from a single thread.
+     * @param bucket Bucket the values fall in.
+     * @param amount Amount of values.
+     */
+    void merge(size_t bucket, uint64_t amount) {
+        counts[bucket].store(counts[bucket].load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        total.store(total.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    /**
+     * Raise the maximum to that of a merged histogram. Must only be called from a single thread.
+     * @param value_ns Maximum of the merged histogram.
+     */
+    void merge_maximum(uint64_t value_ns) {
+        if (value_ns > max.load(std::memory_order_relaxed)) {
+            max.store(value_ns, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Forget all recorded values. Must only be called from the recording thread.
+     */
+    void reset();
+
+    /**
+     * @param fraction Fraction of values to be at or below the result, between 0 and 1.
+     * @return Upper bound of the bucket containing the requested percentile, capped at the maximum, or 0 if nothing was
+     * recorded.
+     */
+    [[nodiscard]] auto percentile(double fraction) const -> uint64_t;
+
+    /**
+     * @return Amount of values recorded in a bucket.
+     */
+    [[nodiscard]] auto bucket_count(size_t bucket) const -> uint64_t {
+        return counts[bucket].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @return Amount of values recorded.
+     */
+    [[nodiscard]] auto count() const -> uint64_t {
+        return total.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @return Highest value recorded.
+     */
+    [[nodiscard]] auto maximum() const -> uint64_t {
+        return max.load(std::memory_order_relaxed);
+    }
+};
+
+#endif //PACKET_GENERATOR_HISTOGRAM_H
@@ -0,0 +1,184 @@
+#ifndef PACKET_GENERATOR_LIVE_STATS_H
+#define PACKET_GENERATOR_LIVE_STATS_H
+
+#include "histogram.h"
+#include "IntervalTimer.h"
+#include "send_path.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/**
+ * Identifies a live statistics segment, "PGLS" in little endian.
+ */
+enum : uint32_t {
+    LIVE_STATS_MAGIC = (0x534C4750),
+    LIVE_STATS_VERSION = (1),
+};
+
+/**
+ * Layout of the shared memory segment the generator publishes its counters in.
+ * Protected by a seqlock: the sequence is odd while the generator is writing, readers retry until they see the same
+ * even sequence before and after copying. All fields are lock-free atomics so that they can be shared between
+ * processes, but the generator only ever writes them with plain stores.
+ */
+struct LiveStatsSegment {
+    std::atomic<uint32_t> magic;
+    std::atomic<uint32_t> version;
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> pid;
+    /**
+     * Whether the generator has stopped sending.
+     */
+    std::atomic<uint32_t> finished;
+    /**
+     * CLOCK_MONOTONIC times of the start of the run and of the last update, in nanoseconds.
+     */
+    std::atomic<uint64_t> start_ns;
+    std::atomic<uint64_t> update_ns;
+    /**
+     * Configured rate and attempted rate since the previous update, in Hz.
+     */
+    std::atomic<double> target_rate;
+    std::atomic<double> current_rate;
+    std::atomic<uint64_t> attempted;
+    std::atomic<uint64_t> successful;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> queued;
+    std::atomic<uint64_t> missed_deadlines;
+    std::atomic<uint64_t> skipped_ticks;
+    /**
+     * Failed send calls, indexed by errno.
+     */
+    std::atomic<uint64_t> errors[MAX_COUNTED_ERRNO + 1];
+    /**
+     * Wake lateness percentiles in nanoseconds.
+     */
+    std::atomic<uint64_t> lateness_p50_ns;
+    std::atomic<uint64_t> lateness_p90_ns;
+    std::atomic<uint64_t> lateness_p99_ns;
+    std::atomic<uint64_t> lateness_p999_ns;
+    std::atomic<uint64_t> lateness_max_ns;
+    /**
+     * Full wake lateness histogram, with buckets as in LatenessHistogram.
+     */
+    std::atomic<uint64_t> lateness_buckets[LatenessHistogram::BUCKETS];
+};
+
+/**
+ * Plain copy of a LiveStatsSegment, as taken by a reader.
+ */
+struct LiveStatsSnapshot {
+    uint32_t pid;
+    bool finished;
+    uint64_t start_ns;
+    uint64_t update_ns;
+    double target_rate;
+    double current_rate;
+    uint64_t attempted;
+    uint64_t successful;
+    uint64_t dropped;
+    uint64_t queued;
+    uint64_t missed_deadlines;
+    uint64_t skipped_ticks;
+    uint64_t errors[MAX_COUNTED_ERRNO + 1];
+    uint64_t lateness_p50_ns;
+    uint64_t lateness_p90_ns;
+    uint64_t lateness_p99_ns;
+    uint64_t lateness_p999_ns;
+    uint64_t lateness_max_ns;
+    uint64_t lateness_buckets[LatenessHistogram::BUCKETS];
+};
+
+/**
+ * Take a consistent copy of a segment, retrying while the generator is writing it.
+ * @param segment Segment to read.
+ * @return Copy of the segment.
+ */
+auto read_live_stats(const LiveStatsSegment &segment) -> LiveStatsSnapshot;
+
+/**
+ * Publishes the generator's counters in a shared memory segment under /dev/shm.
+ * Only the sending thread may publish.
+ */
+class LiveStatsPublisher {
+private:
+    std::string name;
+    LiveStatsSegment *segment{nullptr};
+    /**
+     * Whether the segment was mapped by this publisher.
+     */
+    bool owned{true};
+    uint64_t last_attempted{0};
+    uint64_t last_update_ns{0};
+
+public:
+    /**
+     * Create the segment, replacing any stale segment with the same name.
+     * @param name Name of the segment, as passed to shm_open, or empty for a segment private to this process.
+     */
+    explicit LiveStatsPublisher(std::string name);
+
+    /**
+     * Publish in a segment mapped by someone else, such as a parent process.
+     * @param segment Zeroed or previously published segment, which must outlive the publisher.
+     */
+    explicit LiveStatsPublisher(LiveStatsSegment *segment);
+
+    LiveStatsPublisher(const LiveStatsPublisher &) = delete;
+
+    auto operator=(const LiveStatsPublisher &) -> LiveStatsPublisher & = delete;
+
+    /**
+     * Unmap and remove the segment, if it was created by this publisher.
+     */
+    ~LiveStatsPublisher();
+
+    /**
+     * Mark the start of a run, resetting the counters.
+     * @param target_rate Configured rate in Hz.
+     */
+    void start(double target_rate);
+
+    /**
+     * Publish the current counters.
+     * @param attempted Amount of packets attempted so far.
+     * @param send_stats Counters of the transport.
+     * @param pacer_stats Counters of the timer.
+     */
+    void publish(uint64_t attempted, const SendStats &send_stats, const PacerStats &pacer_stats);
+
+    /**
+     * Publish a new configured rate.
+     * @param target_rate Configured rate in Hz.
+     */
+    void set_target_rate(double target_rate);
+
+    /**
+     * Mark the run as finished.
+     */
+    void finish();
+
+    /**
+     * @return Segment being published, for readers in this process.
+     */
+    [[nodiscard]] auto data() const -> const LiveStatsSegment & {
+        return *segment;
+    }
+};
+
+/**
+ * @return Name of the segment a generator with a pid publishes in by default.
+ */
+auto default_live_stats_name(int pid) -> std::string;
+
+/**
+ * Entry point of packet_generator --attach, which periodically prints the counters a generator publishes.
+ * @param argc Amount of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code.
+ */
+auto attach_main(int argc, char *argv[]) -> int; // NOLINT(modernize-avoid-c-arrays) // Disabled as argv has to be of dynamic length
+
+#endif //PACKET_GENERATOR_LIVE_STATS_H
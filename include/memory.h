@@ -0,0 +1,43 @@
+#ifndef PACKET_GENERATOR_MEMORY_H
+#define PACKET_GENERATOR_MEMORY_H
+
+#include <cstddef>
+
+/**
+ * Size of the huge pages buffers are rounded up to once huge pages are enabled.
+ */
+enum : size_t {
+    HUGE_PAGE_BYTES = (2 * 1024 * 1024),
+};
+
+/**
+ * Back buffers allocated from now on with huge pages, so the hot loop touches fewer TLB entries.
+ * Explicit huge pages are used if reserved in /proc/sys/vm/nr_hugepages, transparent huge pages otherwise.
+ * Must be set before the first buffer is allocated.
+ * @param enabled Whether to use huge pages.
+ */
+void use_huge_pages(bool enabled);
+
+/**
+ * Allocate a zeroed buffer whose pages are all faulted in, so that first use does not take page faults.
+ * Exits if the memory can't be allocated.
+ * @param size Size of the buffer in bytes.
+ * @return Page aligned buffer.
+ */
+auto allocate_buffer(size_t size) -> void *;
+
+/**
+ * Free a buffer from allocate_buffer.
+ * @param buffer Buffer to free, or nullptr.
+ * @param size Size the buffer was allocated with.
+ */
+void free_buffer(void *buffer, size_t size);
+
+/**
+ * Lock all current and future memory of the process, stop malloc from returning memory to the kernel and fault in
+ * the stack and the vDSO clock data, so that the hot loop neither allocates from the kernel nor takes page faults.
+ * Failing to lock memory, without CAP_IPC_LOCK and a large enough RLIMIT_MEMLOCK, is reported but not fatal.
+ */
+void lock_memory();
+
+#endif //PACKET_GENERATOR_MEMORY_H
@@ -0,0 +1,39 @@
+#ifndef PACKET_GENERATOR_NUMA_H
+#define PACKET_GENERATOR_NUMA_H
+
+#include <string>
+#include <vector>
+
+/*
+ * NUMA topology from sysfs, and memory placement through the kernel's memory policy system calls, so that the
+ * generator needs no libnuma.
+ */
+
+/**
+ * @param interface Name of a network interface.
+ * @return NUMA node the interface's device is attached to, or -1 if unknown, as for virtual interfaces or on machines
+ * with a single node.
+ */
+auto interface_numa_node(const std::string &interface) -> int;
+
+/**
+ * @param cpu CPU number.
+ * @return NUMA node of the CPU, or -1 if unknown.
+ */
+auto cpu_numa_node(unsigned int cpu) -> int;
+
+/**
+ * @param node NUMA node.
+ * @return CPUs of the node that the calling thread may run on, in increasing order.
+ */
+auto allowed_numa_node_cpus(int node) -> std::vector<unsigned int>;
+
+/**
+ * Prefer allocating memory for the calling thread, and threads it starts from now on, from a NUMA node, falling back
+ * to other nodes once it is full. Pages already faulted in stay where they are.
+ * Failing to set the policy, as under seccomp filters, is reported but not fatal.
+ * @param node NUMA node.
+ */
+void prefer_numa_node(int node);
+
+#endif //PACKET_GENERATOR_NUMA_H
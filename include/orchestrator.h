@@ -0,0 +1,19 @@
+#ifndef PACKET_GENERATOR_ORCHESTRATOR_H
+#define PACKET_GENERATOR_ORCHESTRATOR_H
+
+#include "arguments.h"
+
+/**
+ * Fork a generator process per instance and report on them combined.
+ * Every instance sends an equal share of the rate on its own CPU, interface and source port range, phase shifted so
+ * that their packets interleave evenly. Their counters are collected from shared memory into a combined line every
+ * second and a combined final report. If an instance fails, the others are stopped and the whole run aborts, as it
+ * does when any instance was less than 95% successful.
+ * Must be called before any thread is started.
+ * @param args Arguments for the whole run.
+ * @param run_instance Runs a single generator with its share of the arguments, returning its exit code.
+ * @return Exit code.
+ */
+auto run_orchestrator(const struct arguments &args, int (*run_instance)(const struct arguments &)) -> int;
+
+#endif //PACKET_GENERATOR_ORCHESTRATOR_H
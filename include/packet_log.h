@@ -0,0 +1,29 @@
+#ifndef PACKET_GENERATOR_PACKET_LOG_H
+#define PACKET_GENERATOR_PACKET_LOG_H
+
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+/**
+ * Write the sequence number into a packet, right after the label byte.
+ * @param packet Packet payload to stamp.
+ * @param packet_num Sequence number of the packet.
+ */
+inline void stamp_packet_num(void *packet, uint32_t packet_num) {
+    const uint32_t network_packet_num{htonl(packet_num)};
+    std::memcpy(&(((char *) packet)[1]), &network_packet_num, 4);
+}
+
+/**
+ * Report the start and end times of the transmit call for a packet.
+ * @param out Stream to write the line to.
+ * @param csv Whether to write a csv line instead of a human-readable one.
+ * @param packet_num Sequence number of the packet.
+ * @param pre_send_ticks Time right before the transmit call, in clock ticks.
+ * @param post_send_ticks Time right after the transmit call, in clock ticks.
+ */
+void log_packet(std::ostream &out, bool csv, uint32_t packet_num, uint64_t pre_send_ticks, uint64_t post_send_ticks);
+
+#endif //PACKET_GENERATOR_PACKET_LOG_H
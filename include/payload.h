@@ -0,0 +1,127 @@
+#ifndef PACKET_GENERATOR_PAYLOAD_H
+#define PACKET_GENERATOR_PAYLOAD_H
+
+#include "crc32c.h"
+
+#include <arpa/inet.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/*
+ * Payloads start with the label byte and the sequence number, followed by the body. With CRCs enabled, the last
+ * 4 bytes hold the CRC32C of the body followed by the label and sequence number, in network byte order. The body
+ * comes first so that its CRC can be computed once per buffer, leaving only 5 bytes per packet.
+ */
+
+/**
+ * Bytes in front of the body: label byte and sequence number.
+ */
+const size_t PAYLOAD_HEADER_BYTES{5};
+/**
+ * Bytes of the CRC trailer.
+ */
+const size_t CRC_TRAILER_BYTES{4};
+
+/**
+ * What packet bodies are filled with.
+ */
+enum class PayloadMode {
+    /**
+     * Zero bytes.
+     */
+    zero,
+    /**
+     * Pseudo-random bytes from a seed, different for every buffer in the pool.
+     */
+    random,
+    /**
+     * Bytes counting up from the buffer's position in the pool.
+     */
+    pattern,
+    /**
+     * Consecutive slices of a file.
+     */
+    file,
+};
+
+/**
+ * Parse a payload mode from its name.
+ * @param name One of "zero", "random", "pattern" or "file".
+ * @return Parsed mode. Exits on unknown names.
+ */
+auto parse_payload_mode(const std::string &name) -> PayloadMode;
+
+/**
+ * Fills the bodies of a pool of packet buffers.
+ */
+class PayloadSource {
+private:
+    PayloadMode mode;
+    uint64_t seed;
+    /**
+     * Mapped file to slice, for the file mode.
+     */
+    const uint8_t *file_data{nullptr};
+    size_t file_size{0};
+
+public:
+    /**
+     * @param mode What to fill bodies with.
+     * @param seed Seed for the random mode.
+     * @param file File to map for the file mode. Exits if it can't be mapped or is empty.
+     */
+    PayloadSource(PayloadMode mode, uint64_t seed, const std::string &file);
+
+    PayloadSource(const PayloadSource &) = delete;
+
+    auto operator=(const PayloadSource &) -> PayloadSource & = delete;
+
+    ~PayloadSource();
+
+    /**
+     * Fill the body of a buffer.
+     * @param body First byte after the sequence number.
+     * @param length Length of the body in bytes.
+     * @param index Position of the buffer in the pool, so that every buffer gets different content.
+     */
+    void fill(uint8_t *body, size_t length, uint32_t index) const;
+};
+
+/**
+ * @param payload Payload with its body filled in.
+ * @param payload_size Size of the payload in bytes, including the trailer.
+ * @return Running CRC32C state over the body, to be finished by stamp_crc().
+ */
+inline auto body_crc(const uint8_t *payload, size_t payload_size) -> uint32_t {
+    return crc32c_extend(~0U, payload + PAYLOAD_HEADER_BYTES, payload_size - PAYLOAD_HEADER_BYTES - CRC_TRAILER_BYTES);
+}
+
+/**
+ * Write the CRC trailer of a payload whose label and sequence number are in place.
+ * @param payload Payload to stamp.
+ * @param payload_size Size of the payload in bytes, including the trailer.
+ * @param body_state State returned by body_crc() for this payload.
+ */
+inline void stamp_crc(uint8_t *payload, size_t payload_size, uint32_t body_state) {
+    const uint32_t network_crc{htonl(~crc32c_extend(body_state, payload, PAYLOAD_HEADER_BYTES))};
+    std::memcpy(payload + payload_size - CRC_TRAILER_BYTES, &network_crc, CRC_TRAILER_BYTES);
+}
+
+/**
+ * @param payload Received payload.
+ * @param length Length of the payload in bytes.
+ * @return Whether the payload is long enough to carry a CRC trailer and the trailer matches.
+ */
+inline auto check_crc(const uint8_t *payload, size_t length) -> bool {
+    if (length < PAYLOAD_HEADER_BYTES + CRC_TRAILER_BYTES) {
+        return false;
+    }
+    uint32_t network_crc;
+    std::memcpy(&network_crc, payload + length - CRC_TRAILER_BYTES, CRC_TRAILER_BYTES);
+    const uint32_t state{crc32c_extend(body_crc(payload, length), payload, PAYLOAD_HEADER_BYTES)};
+    return ~state == ntohl(network_crc);
+}
+
+#endif //PACKET_GENERATOR_PAYLOAD_H
@@ -0,0 +1,112 @@
+#ifndef PACKET_GENERATOR_PCAP_READER_H
+#define PACKET_GENERATOR_PCAP_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * UDP payload found in a capture, pointing into the mapped file.
+ */
+struct CapturedPacket {
+    /**
+     * Capture time in nanoseconds since the epoch.
+     */
+    int64_t timestamp_ns;
+    const uint8_t *payload;
+    size_t length;
+};
+
+/**
+ * Streams the UDP payloads of IPv4 packets out of a pcap or pcapng file.
+ * The file is mapped rather than read, with read-ahead in front of the cursor and pages behind it released, so
+ * captures larger than memory can be replayed.
+ * Understands Ethernet (with VLAN tags), raw IP, Linux cooked (v1 and v2) and BSD loopback link types. Other
+ * packets, fragments and truncated headers are skipped.
+ */
+class PcapReader {
+private:
+    /**
+     * Link type and timestamp resolution of a pcapng interface, or of the whole pcap file.
+     */
+    struct Interface {
+        uint32_t link_type;
+        /**
+         * Timestamp units per second, as a power of 10 or 2.
+         */
+        uint8_t resolution;
+        bool binary_resolution;
+    };
+
+    int fd{-1};
+    const uint8_t *data{nullptr};
+    size_t size{0};
+    size_t offset{0};
+    bool pcapng{false};
+    /**
+     * Whether the file was written with the other byte order.
+     */
+    bool swapped{false};
+    std::vector<Interface> interfaces;
+    /**
+     * Offset up to which read-ahead was requested and pages were released.
+     */
+    size_t advised_offset{0};
+    uint64_t skipped_packets{0};
+
+    [[nodiscard]] auto read16(size_t at) const -> uint16_t;
+
+    [[nodiscard]] auto read32(size_t at) const -> uint32_t;
+
+    /**
+     * Request the next window and release the one behind the cursor.
+     */
+    void advise();
+
+    /**
+     * Find the UDP payload in a captured frame.
+     * @return Whether the frame holds a complete IPv4 UDP header.
+     */
+    static auto udp_payload(uint32_t link_type, const uint8_t *frame, size_t length, CapturedPacket &packet) -> bool;
+
+    /**
+     * Convert a timestamp in an interface's units to nanoseconds.
+     */
+    static auto to_ns(uint64_t timestamp, const Interface &interface) -> int64_t;
+
+    /**
+     * Parse a pcapng block at the cursor.
+     * @return Whether the block was an enhanced packet block whose payload was stored.
+     */
+    auto next_pcapng_block(CapturedPacket &packet) -> bool;
+
+public:
+    /**
+     * Map a capture and read its header. Exits if the file can't be read or is not a capture.
+     * @param path File to replay.
+     */
+    explicit PcapReader(const std::string &path);
+
+    PcapReader(const PcapReader &) = delete;
+
+    auto operator=(const PcapReader &) -> PcapReader & = delete;
+
+    ~PcapReader();
+
+    /**
+     * Move to the next UDP payload.
+     * @param packet Overwritten with the packet, which stays valid until the reader is destroyed.
+     * @return False once the end of the file is reached.
+     */
+    auto next(CapturedPacket &packet) -> bool;
+
+    /**
+     * @return Captured packets that were not replayable UDP payloads.
+     */
+    [[nodiscard]] auto skipped() const -> uint64_t {
+        return skipped_packets;
+    }
+};
+
+#endif //PACKET_GENERATOR_PCAP_READER_H
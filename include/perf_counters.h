@@ -0,0 +1,93 @@
+#ifndef PACKET_GENERATOR_PERF_COUNTERS_H
+#define PACKET_GENERATOR_PERF_COUNTERS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Events counted around the send loop.
+ */
+enum PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_CONTEXT_SWITCHES,
+    PERF_PAGE_FAULTS,
+    PERF_EVENT_COUNT,
+};
+
+/**
+ * Value of every counter at one moment.
+ */
+struct PerfSample {
+    uint64_t values[PERF_EVENT_COUNT]{};
+};
+
+/**
+ * Counter deltas over a named phase of a run.
+ */
+struct PerfPhase {
+    std::string name;
+    PerfSample start;
+    PerfSample end;
+};
+
+/**
+ * Hardware and software performance counters for the calling thread, read with perf_event_open.
+ * Counters the kernel does not permit or support are left out, so that the rest still work.
+ */
+class PerfCounters {
+private:
+    int fds[PERF_EVENT_COUNT];
+    /**
+     * Whether the kernel part of each counter is excluded, because counting it was not permitted.
+     */
+    bool user_only[PERF_EVENT_COUNT]{};
+
+public:
+    /**
+     * Open and start all counters on the calling thread, reporting those that could not be opened.
+     */
+    PerfCounters();
+
+    PerfCounters(const PerfCounters &) = delete;
+
+    auto operator=(const PerfCounters &) -> PerfCounters & = delete;
+
+    ~PerfCounters();
+
+    /**
+     * @return Current value of every counter, scaled up if the kernel multiplexed it. Unavailable counters read 0.
+     */
+    [[nodiscard]] auto read() const -> PerfSample;
+
+    /**
+     * @return Whether a counter could be opened.
+     */
+    [[nodiscard]] auto available(PerfEvent event) const -> bool {
+        return fds[event] >= 0;
+    }
+
+    /**
+     * @return Whether a counter only covers user space.
+     */
+    [[nodiscard]] auto is_user_only(PerfEvent event) const -> bool {
+        return user_only[event];
+    }
+
+    /**
+     * @return Human-readable name of a counter.
+     */
+    static auto name(PerfEvent event) -> const char *;
+};
+
+/**
+ * Print the per-packet average of every available counter for each phase.
+ * @param counters Counters the phases were sampled from.
+ * @param phases Phases to report.
+ * @param packets Amount of packets to divide by.
+ */
+void report_perf_phases(const PerfCounters &counters, const std::vector<PerfPhase> &phases, uint64_t packets);
+
+#endif //PACKET_GENERATOR_PERF_COUNTERS_H
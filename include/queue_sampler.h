@@ -0,0 +1,142 @@
+#ifndef PACKET_GENERATOR_QUEUE_SAMPLER_H
+#define PACKET_GENERATOR_QUEUE_SAMPLER_H
+
+#include "event_loop.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Occupancy of every queue between the generator and the wire at one point in time.
+ * Kernel counters are cumulative, as the kernel reports them.
+ */
+struct QueueSample {
+    /**
+     * CLOCK_MONOTONIC time since sampling started, in nanoseconds.
+     */
+    int64_t time_ns;
+    /**
+     * Packets the sending thread attempted and successfully handed to the kernel so far.
+     */
+    uint64_t attempted;
+    uint64_t successful;
+    /**
+     * Bytes in the socket send queue, including the kernel's overhead per packet, or -1 without a socket.
+     */
+    int64_t socket_queued_bytes;
+    /**
+     * Root qdisc of the interface.
+     */
+    uint32_t qdisc_packets;
+    uint32_t qdisc_backlog_bytes;
+    uint64_t qdisc_drops;
+    uint64_t qdisc_requeues;
+    uint64_t qdisc_overlimits;
+    /**
+     * Packets the driver dropped or failed to transmit.
+     */
+    uint64_t driver_tx_dropped;
+    uint64_t driver_tx_errors;
+};
+
+/**
+ * Samples the socket send queue with SIOCOUTQ, and the root qdisc and driver counters of an interface over
+ * rtnetlink, at a low rate on an event loop. Every sample is paired with the sending thread's counters at that time,
+ * so that periods with send failures can be attributed to the queue that was full.
+ */
+class QueueSampler {
+private:
+    EventLoop &loop;
+    int timer_fd{-1};
+    int netlink_fd{-1};
+    uint32_t netlink_sequence{0};
+    int interface_index{0};
+    std::string interface;
+    int64_t period_ns;
+    /**
+     * Written by the sending thread, read when sampling.
+     */
+    std::atomic<uint64_t> attempted{0};
+    std::atomic<uint64_t> successful{0};
+    /**
+     * Protects everything below, which changes between runs.
+     */
+    std::mutex mutex;
+    bool sampling{false};
+    int socket_fd{-1};
+    int socket_buffer_bytes{0};
+    int64_t start_ns{0};
+    std::string qdisc_kind;
+    std::vector<QueueSample> samples;
+
+    /**
+     * Take a sample, called from the event loop.
+     */
+    void sample();
+
+    /**
+     * Read the root qdisc of the interface into a sample.
+     */
+    void read_qdisc(QueueSample &res);
+
+    /**
+     * Read the driver counters of the interface into a sample.
+     */
+    void read_link(QueueSample &res);
+
+public:
+    /**
+     * Arm a periodic timer on the event loop. Samples are only taken between start() and stop().
+     * @param loop Event loop to sample on, not yet started.
+     * @param interface Interface to sample the qdisc and driver of, or empty for only the socket.
+     * @param period_ms Milliseconds between samples.
+     */
+    QueueSampler(EventLoop &loop, std::string interface, unsigned int period_ms);
+
+    QueueSampler(const QueueSampler &) = delete;
+
+    auto operator=(const QueueSampler &) -> QueueSampler & = delete;
+
+    /**
+     * Unwatch and close the timer and close the netlink socket. The event loop must be stopped first, but not yet
+     * destroyed.
+     */
+    ~QueueSampler();
+
+    /**
+     * Discard earlier samples and start sampling a run.
+     * @param new_socket_fd Socket to sample the send queue of, or -1. Must stay open until stop().
+     */
+    void start(int new_socket_fd);
+
+    /**
+     * Stop sampling, keeping the samples taken.
+     */
+    void stop();
+
+    /**
+     * Publish the sending thread's counters for the next sample. Cheap enough to call at every deadline.
+     */
+    void note_sends(uint64_t new_attempted, uint64_t new_successful) {
+        attempted.store(new_attempted, std::memory_order_relaxed);
+        successful.store(new_successful, std::memory_order_relaxed);
+    }
+
+    /**
+     * Print peak occupancies, kernel drops over the run, and which queues were full while sends failed.
+     * @param out Stream to print to.
+     */
+    void summarise(std::ostream &out);
+
+    /**
+     * Write every sample to a CSV file.
+     * @param path File to write, truncated if it exists.
+     */
+    void write_log(const std::string &path);
+};
+
+#endif //PACKET_GENERATOR_QUEUE_SAMPLER_H
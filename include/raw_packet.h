@@ -0,0 +1,115 @@
+#ifndef PACKET_GENERATOR_RAW_PACKET_H
+#define PACKET_GENERATOR_RAW_PACKET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <netinet/in.h>
+#include <string>
+
+/**
+ * IPv4/UDP datagram built once and re-stamped for every packet sent over a raw socket.
+ * Source addresses and ports rotate over a range so that traffic spreads over receive queues.
+ * Only the changed words are summed per packet, the checksum over the constant remainder is computed up front.
+ */
+class RawPacketTemplate {
+private:
+    /**
+     * Complete datagram, starting at the IP header, with the source and checksums still zero.
+     */
+    uint8_t *buffer{nullptr};
+    /**
+     * Length of the complete datagram in bytes.
+     */
+    size_t length{0};
+    /**
+     * Length of the UDP payload in bytes.
+     */
+    size_t payload_size{0};
+    /**
+     * Offset into the payload from which words change between packets again, at the trailer.
+     */
+    size_t trailer_start{0};
+    /**
+     * First source address and port to rotate over, in host byte order.
+     */
+    uint32_t first_src_ip{0};
+    uint16_t first_src_port{0};
+    /**
+     * Size of the source address and port ranges.
+     */
+    uint32_t src_ip_count{1};
+    uint32_t src_port_count{1};
+    /**
+     * Position in the source address and port ranges of the next packet.
+     */
+    uint32_t src_ip_index{0};
+    uint32_t src_port_index{0};
+    /**
+     * Unfolded checksums over the header words that do not change between packets.
+     */
+    uint64_t ip_base_sum{0};
+    uint64_t udp_base_sum{0};
+
+public:
+    /**
+     * Build the headers and payload of the datagram.
+     * @param dest_ip Destination address in network byte order.
+     * @param dest_port Destination port in host byte order.
+     * @param src_ip First source address in network byte order.
+     * @param src_ip_count Amount of consecutive source addresses to rotate over.
+     * @param src_port First source port in host byte order.
+     * @param src_port_count Amount of consecutive source ports to rotate over.
+     * @param tos Value of the IP ToS byte.
+     * @param label_byte Byte to label transmissions with.
+     * @param payload_size Size of the UDP payload in bytes.
+     * @param trailer_bytes Bytes at the end of the payload that change between packets.
+     */
+    RawPacketTemplate(in_addr_t dest_ip, uint16_t dest_port, in_addr_t src_ip, uint32_t src_ip_count,
+                      uint16_t src_port, uint32_t src_port_count, uint8_t tos, uint8_t label_byte,
+                      size_t payload_size, size_t trailer_bytes = 0);
+
+    RawPacketTemplate(const RawPacketTemplate &) = delete;
+
+    auto operator=(const RawPacketTemplate &) -> RawPacketTemplate & = delete;
+
+    ~RawPacketTemplate();
+
+    /**
+     * Copy the datagram into a packet slot, so that it can be stamped with prepare().
+     * @param slot Buffer of at least size() bytes.
+     */
+    void copy_to(void *slot) const;
+
+    /**
+     * Sum the payload words of a slot that do not change between packets, once its body is filled in.
+     * @param slot Buffer previously filled by copy_to().
+     * @return Unfolded sum to pass to prepare() for this slot.
+     */
+    [[nodiscard]] auto body_sum(const void *slot) const -> uint64_t;
+
+    /**
+     * Stamp the next packet with its sequence number and source, and patch both checksums.
+     * The trailer, if any, has to be written before.
+     * @param packet_num Sequence number of the packet.
+     * @param slot Buffer previously filled by copy_to().
+     * @param slot_body_sum Sum returned by body_sum() for this slot.
+     */
+    void prepare(uint32_t packet_num, void *slot, uint64_t slot_body_sum = 0);
+
+    /**
+     * @return Length of the complete datagram in bytes.
+     */
+    [[nodiscard]] auto size() const -> size_t {
+        return length;
+    }
+};
+
+/**
+ * Find the address the kernel would send from when sending to a destination.
+ * @param dest_ip Destination address in network byte order.
+ * @param interface Interface to bind to, or empty to use the routing table only.
+ * @return Source address in network byte order.
+ */
+auto resolve_source_address(in_addr_t dest_ip, const std::string &interface) -> in_addr_t;
+
+#endif //PACKET_GENERATOR_RAW_PACKET_H
@@ -0,0 +1,71 @@
+#ifndef PACKET_GENERATOR_RECEIVER_H
+#define PACKET_GENERATOR_RECEIVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+/**
+ * Receives packets sent by a generator on a background thread and counts them.
+ * Used as the cooperating end of a loss measurement on the local host.
+ */
+class Receiver {
+private:
+    int socket_fd{-1};
+    uint8_t label_byte;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> received{0};
+    /**
+     * Buffer to write arrival times to, indexed like the generator's send times.
+     */
+    int64_t *arrival_times_ns{nullptr};
+    uint32_t arrival_times_capacity{0};
+    uint32_t arrival_times_stride{1};
+
+    /**
+     * Receive packets until stopped.
+     */
+    void receive_loop();
+
+public:
+    /**
+     * Bind to a port, but do not start receiving.
+     * @param port Port to receive on.
+     * @param label_byte Only packets with this label are counted.
+     * @param interface Interface to bind to, or empty for all interfaces.
+     */
+    Receiver(unsigned int port, uint8_t label_byte, const std::string &interface);
+
+    Receiver(const Receiver &) = delete;
+
+    auto operator=(const Receiver &) -> Receiver & = delete;
+
+    /**
+     * Stop receiving and close the socket.
+     */
+    ~Receiver();
+
+    /**
+     * Discard everything received so far, reset the counter and start receiving.
+     * @param arrival_times_ns Buffer to write CLOCK_REALTIME arrival times in nanoseconds to, or nullptr.
+     * @param capacity Amount of arrival times the buffer holds.
+     * @param stride Record packets whose sequence number is a multiple of this.
+     */
+    void start(int64_t *arrival_times_ns = nullptr, uint32_t capacity = 0, uint32_t stride = 1);
+
+    /**
+     * Stop receiving, after which the counter and arrival times are final.
+     */
+    void stop();
+
+    /**
+     * @return Amount of labelled packets received since the last reset.
+     */
+    [[nodiscard]] auto count() const -> uint64_t {
+        return received.load(std::memory_order_acquire);
+    }
+};
+
+#endif //PACKET_GENERATOR_RECEIVER_H
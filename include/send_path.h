@@ -0,0 +1,173 @@
+#ifndef PACKET_GENERATOR_SEND_PATH_H
+#define PACKET_GENERATOR_SEND_PATH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+
+/**
+ * Highest errno value that is counted separately, higher values share the last counter.
+ */
+enum {
+    MAX_COUNTED_ERRNO = (255),
+};
+
+/**
+ * What to do when the socket buffer is full (EAGAIN or ENOBUFS).
+ */
+enum class BackpressurePolicy {
+    /**
+     * Drop the packet and count it.
+     */
+    drop,
+    /**
+     * Keep the packet in a bounded queue that is drained once the socket is writable again.
+     */
+    queue,
+    /**
+     * Wait for the socket to become writable, up to a deadline.
+     */
+    block,
+};
+
+/**
+ * Parse a backpressure policy from its name.
+ * @param name One of "drop", "queue" or "block".
+ * @return Parsed policy. Exits on unknown names.
+ */
+auto parse_backpressure_policy(const std::string &name) -> BackpressurePolicy;
+
+/**
+ * Counters kept by the send path.
+ */
+struct SendStats {
+    /**
+     * Packets that were handed to the kernel.
+     */
+    uint64_t successful{0};
+    /**
+     * Packets that were given up on.
+     */
+    uint64_t dropped{0};
+    /**
+     * Packets that were put in the retry queue.
+     */
+    uint64_t queued{0};
+    /**
+     * Failed send calls, indexed by errno.
+     */
+    uint64_t errors[MAX_COUNTED_ERRNO + 1]{};
+};
+
+/**
+ * Sends packets over a non-blocking socket and handles a full socket buffer according to a BackpressurePolicy.
+ * Never prints anything per packet, failures are only counted.
+ */
+class SendPath {
+private:
+    int socket_fd;
+    sockaddr_in dest_addr;
+    BackpressurePolicy policy;
+    /**
+     * Longest time to wait for the socket to become writable under the block policy.
+     */
+    timespec block_deadline;
+    /**
+     * Ring buffer of queued packets, each in a slot of max_packet_size bytes.
+     */
+    uint8_t *queue_slots{nullptr};
+    size_t *queue_lengths{nullptr};
+    size_t queue_capacity;
+    size_t max_packet_size;
+    size_t queue_head{0};
+    size_t queue_length{0};
+    SendStats send_stats{};
+    /**
+     * Message headers for sending a whole batch in one system call.
+     */
+    mmsghdr *batch_messages{nullptr};
+    iovec *batch_iovecs{nullptr};
+    size_t max_batch;
+
+    /**
+     * Attempt a single send call and count its failure.
+     * @return 0 on success, otherwise errno of the failed call.
+     */
+    auto try_send(const void *packet, size_t length) -> int;
+
+    /**
+     * Send as many queued packets as the socket accepts.
+     */
+    void drain_queue();
+
+    /**
+     * Copy a packet to the back of the queue, dropping it if the queue is full.
+     */
+    void enqueue(const void *packet, size_t length);
+
+    /**
+     * Keep retrying a packet until it is sent or the block deadline passes.
+     */
+    void send_blocking(const void *packet, size_t length);
+
+public:
+    /**
+     * @param socket_fd Non-blocking socket to send over.
+     * @param dest_addr Address to send to.
+     * @param policy What to do when the socket buffer is full.
+     * @param queue_capacity Amount of packets the retry queue holds under the queue policy.
+     * @param max_packet_size Largest packet that will be sent, used to size the retry queue.
+     * @param block_deadline_us Longest time to wait under the block policy in microseconds.
+     * @param max_batch Most packets passed to send_batch at once.
+     */
+    SendPath(int socket_fd, const sockaddr_in &dest_addr, BackpressurePolicy policy, size_t queue_capacity,
+             size_t max_packet_size, long block_deadline_us, size_t max_batch = 1);
+
+    SendPath(const SendPath &) = delete;
+
+    auto operator=(const SendPath &) -> SendPath & = delete;
+
+    ~SendPath();
+
+    /**
+     * Send a packet, applying the backpressure policy if the socket buffer is full.
+     * @param packet Packet contents, only needs to stay valid for the duration of the call.
+     * @param length Length of the packet in bytes.
+     */
+    void send(const void *packet, size_t length);
+
+    /**
+     * Send several packets in a single system call where possible, applying the backpressure policy to each
+     * packet the socket does not accept.
+     * @param packets Packet contents, only need to stay valid for the duration of the call.
+     * @param lengths Length of each packet in bytes.
+     * @param count Amount of packets, at most max_batch.
+     */
+    void send_batch(const void *const *packets, const size_t *lengths, size_t count);
+
+    /**
+     * Try to send all queued packets, waiting for the socket to become writable until the timeout passes.
+     * Packets still queued afterwards are counted as dropped.
+     * @param timeout_us Longest time to wait in microseconds.
+     */
+    void flush(long timeout_us);
+
+    /**
+     * Reset all counters to zero.
+     */
+    void reset_stats() {
+        send_stats = SendStats{};
+    }
+
+    /**
+     * @return Counters kept so far.
+     */
+    [[nodiscard]] auto stats() const -> const SendStats & {
+        return send_stats;
+    }
+};
+
+#endif //PACKET_GENERATOR_SEND_PATH_H
@@ -1,11 +1,26 @@
 #ifndef PACKET_GENERATOR_SIGNAL_HANDLING_H
 #define PACKET_GENERATOR_SIGNAL_HANDLING_H
 
+#include "event_loop.h"
+
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <pthread.h>
+
+/**
+ * Set once the user asked the generator to stop.
+ */
+extern std::atomic<bool> keyboard_interrupt;
 
 /**
- * Register handlers for keyboard interrupts and missed alarms.
+ * Handle keyboard interrupts on an event loop instead of in an asynchronous signal handler.
+ * Blocks SIGINT and SIGTERM in the calling thread, which must be the sending thread, and every thread it starts
+ * afterwards, so call this before starting any thread.
+ * On an interrupt, keyboard_interrupt is set and any blocking wait of the sending thread is interrupted.
+ * @param loop Event loop to receive the signals on.
+ * @param on_interrupt Called on the loop's thread after keyboard_interrupt is set, or empty.
  */
-void register_handlers();
+void register_handlers(EventLoop &loop, std::function<void()> on_interrupt = {});
 
 #endif //PACKET_GENERATOR_SIGNAL_HANDLING_H
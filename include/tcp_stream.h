@@ -0,0 +1,72 @@
+#ifndef PACKET_GENERATOR_TCP_STREAM_H
+#define PACKET_GENERATOR_TCP_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+
+struct arguments;
+
+/**
+ * Counters of a TCP stream, partly as reported by the kernel in TCP_INFO.
+ */
+struct TcpStreamStats {
+    /**
+     * Bytes handed to the socket.
+     */
+    uint64_t bytes_sent;
+    /**
+     * Bytes still in the send queue, not yet acknowledged by the receiver.
+     */
+    uint64_t bytes_unacked;
+    uint32_t total_retransmits;
+    /**
+     * Smoothed round-trip time and its variation in microseconds.
+     */
+    uint32_t rtt_us;
+    uint32_t rtt_var_us;
+    /**
+     * Congestion window in segments, and the segment size in bytes.
+     */
+    uint32_t congestion_window;
+    uint32_t mss;
+};
+
+/**
+ * Bulk TCP traffic to the destination, pushed from a file with sendfile() so the data is never copied to user space.
+ * Without a file, a tmpfs-backed memfd is filled with the configured payload once and sent over and over.
+ */
+class TcpStream {
+private:
+    int socket_fd{-1};
+    int file_fd{-1};
+    size_t file_size{0};
+    uint64_t bytes_sent{0};
+
+public:
+    /**
+     * Open the data file and connect to dest_ip:dest_port, bound to the configured interface and with the configured
+     * DSCP and pacing rate. Exits on failure.
+     * @param args Arguments to take the destination and stream settings from.
+     */
+    explicit TcpStream(const struct arguments &args);
+
+    TcpStream(const TcpStream &) = delete;
+
+    auto operator=(const TcpStream &) -> TcpStream & = delete;
+
+    ~TcpStream();
+
+    /**
+     * Push data until the timeout passes, the user interrupts or the receiver closes the connection.
+     * @param timeout_ticks Time to send for in clock ticks, 0 to run until interrupted.
+     * @return Time spent sending in clock ticks.
+     */
+    auto run(uint64_t timeout_ticks) -> uint64_t;
+
+    /**
+     * @return Counters so far, with the kernel's view of the connection.
+     */
+    [[nodiscard]] auto stats() const -> TcpStreamStats;
+};
+
+#endif //PACKET_GENERATOR_TCP_STREAM_H
@@ -0,0 +1,127 @@
+#ifndef PACKET_GENERATOR_TRACE_H
+#define PACKET_GENERATOR_TRACE_H
+
+#include "constants.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+/**
+ * A single entry on the timeline.
+ */
+struct TraceEvent {
+    /**
+     * CLOCK_MONOTONIC time the event started at, in nanoseconds.
+     */
+    int64_t start_ns;
+    /**
+     * Duration in nanoseconds, or -1 for an instant event.
+     */
+    int64_t duration_ns;
+    /**
+     * Name of the event, which must be a string literal.
+     */
+    const char *name;
+    /**
+     * Name of the event's value, which must be a string literal, or nullptr if it has none.
+     */
+    const char *value_name;
+    uint64_t value;
+    /**
+     * Thread the event happened on.
+     */
+    int32_t tid;
+};
+
+/**
+ * Preallocated events of one named thread. Threads that reuse a name, such as successive receivers, share a buffer.
+ * Only the thread currently registered under the name writes to it.
+ */
+struct TraceBuffer {
+    std::string thread_name;
+    int32_t tid;
+    TraceEvent *events;
+    size_t capacity;
+    size_t count;
+    /**
+     * Events that did not fit and were dropped.
+     */
+    uint64_t dropped;
+};
+
+/**
+ * Buffer of the calling thread, or nullptr while the thread is not traced.
+ */
+extern thread_local TraceBuffer *thread_trace;
+
+/**
+ * Start tracing threads that register from now on. Must be called before any traced thread starts.
+ * @param capacity Events to preallocate per thread. Later events are dropped.
+ */
+void enable_tracing(size_t capacity);
+
+/**
+ * Trace the calling thread, if tracing is enabled. Allocates its buffer, so call this before the thread's hot loop.
+ * @param name Name to show for the thread.
+ */
+void trace_thread(const std::string &name);
+
+/**
+ * Write every traced event to a file in Chrome trace event JSON, which Perfetto and chrome://tracing open.
+ * Must only be called once traced threads have stopped or are not recording.
+ * @param path File to write to.
+ */
+void write_trace(const std::string &path);
+
+/**
+ * @return Whether the calling thread is traced.
+ */
+inline auto tracing() -> bool {
+    return thread_trace != nullptr;
+}
+
+/**
+ * @return Current time on the trace clock in nanoseconds.
+ */
+inline auto trace_now() -> int64_t {
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * S_TO_NS + now.tv_nsec;
+}
+
+/**
+ * Record an event on the calling thread's timeline. Does nothing if the thread is not traced.
+ */
+inline void trace_event(const char *name, int64_t start_ns, int64_t duration_ns, const char *value_name = nullptr,
+                        uint64_t value = 0) {
+    TraceBuffer *buffer{thread_trace};
+    if (buffer == nullptr) {
+        return;
+    }
+    if (buffer->count == buffer->capacity) {
+        buffer->dropped++;
+        return;
+    }
+    buffer->events[buffer->count++] = {start_ns, duration_ns, name, value_name, value, buffer->tid};
+}
+
+/**
+ * Record an event that lasted from start_ns until now.
+ */
+inline void trace_complete(const char *name, int64_t start_ns, const char *value_name = nullptr,
+                           uint64_t value = 0) {
+    if (tracing()) {
+        trace_event(name, start_ns, trace_now() - start_ns, value_name, value);
+    }
+}
+
+/**
+ * Record an event without duration.
+ */
+inline void trace_instant(const char *name, int64_t at_ns, const char *value_name = nullptr, uint64_t value = 0) {
+    trace_event(name, at_ns, -1, value_name, value);
+}
+
+#endif //PACKET_GENERATOR_TRACE_H
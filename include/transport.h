@@ -0,0 +1,268 @@
+#ifndef PACKET_GENERATOR_TRANSPORT_H
+#define PACKET_GENERATOR_TRANSPORT_H
+
+#include "send_path.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+
+struct arguments;
+
+/**
+ * Most packets handed to a transport at once.
+ */
+enum {
+    MAX_BATCH = (64),
+};
+
+/**
+ * Where packets are transmitted to.
+ */
+enum class TransportType {
+    /**
+     * UDP or raw socket to the configured destination.
+     */
+    socket,
+    /**
+     * Discard packets without a system call, to measure the generator on its own.
+     */
+    null,
+    /**
+     * UDP socket to the destination port on the loopback interface.
+     */
+    loopback,
+    /**
+     * Append packets with their IP and UDP headers to a pcap file.
+     */
+    pcap,
+    /**
+     * Stream bulk data over a TCP connection instead of sending datagrams, see TcpStream.
+     */
+    tcp,
+    /**
+     * Write Ethernet frames into a queue of the TAP device named by the interface, see TapTransport.
+     */
+    tap,
+    /**
+     * Transmit Ethernet frames in bursts on a DPDK port, see DpdkTransport. Only in builds made with make dpdk.
+     */
+    dpdk,
+};
+
+/**
+ * Parse a transport type from its name.
+ * @param name One of "socket", "null", "loopback", "pcap", "tcp", "tap" or "dpdk".
+ * @return Parsed transport type. Exits on unknown names.
+ */
+auto parse_transport_type(const std::string &name) -> TransportType;
+
+/**
+ * A packet ready to be transmitted.
+ */
+struct OutgoingPacket {
+    const void *data;
+    size_t length;
+};
+
+/**
+ * Transmits batches of packets.
+ * Implementations count their own successes and failures and never print anything per packet.
+ */
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    /**
+     * Transmit a batch of packets.
+     * @param packets Packets to transmit, which only need to stay valid for the duration of the call.
+     * @param count Amount of packets in the batch, at most MAX_BATCH.
+     */
+    virtual void send_batch(const OutgoingPacket *packets, size_t count) = 0;
+
+    /**
+     * Finish transmitting anything still pending, waiting at most the timeout.
+     * @param timeout_us Longest time to wait in microseconds.
+     */
+    virtual void flush([[maybe_unused]] long timeout_us) {}
+
+    /**
+     * Change the ToS byte of packets whose IP header the transport builds itself.
+     * @param tos DSCP shifted into the ToS byte.
+     */
+    virtual void set_tos([[maybe_unused]] uint8_t tos) {}
+
+    /**
+     * Reset all counters to zero.
+     */
+    virtual void reset_stats() = 0;
+
+    /**
+     * @return Counters kept so far.
+     */
+    [[nodiscard]] virtual auto stats() const -> const SendStats & = 0;
+
+    /**
+     * @return Whether packets handed to this transport must start with an IP header.
+     */
+    [[nodiscard]] virtual auto needs_ip_headers() const -> bool = 0;
+    /**
+     * @return Socket whose send queue the kernel holds packets in, or -1 if the transport has none.
+     */
+    [[nodiscard]] virtual auto queue_fd() const -> int {
+        return -1;
+    }
+};
+
+/**
+ * Sends over a UDP or raw socket, handling a full socket buffer with the configured backpressure policy.
+ */
+class SocketTransport final : public Transport {
+private:
+    int socket_fd{-1};
+    std::unique_ptr<SendPath> send_path;
+    bool raw;
+
+public:
+    /**
+     * Open the socket, bound to the configured interface.
+     * @param args Arguments to take the socket type, interface, DSCP and backpressure policy from.
+     * @param dest_addr Address to send to.
+     * @param max_packet_size Largest packet that will be sent.
+     */
+    SocketTransport(const struct arguments &args, const sockaddr_in &dest_addr, size_t max_packet_size);
+
+    ~SocketTransport() override;
+
+    void send_batch(const OutgoingPacket *packets, size_t count) override;
+
+    void flush(long timeout_us) override;
+
+    void set_tos(uint8_t tos) override;
+
+    void reset_stats() override {
+        send_path->reset_stats();
+    }
+
+    [[nodiscard]] auto stats() const -> const SendStats & override {
+        return send_path->stats();
+    }
+
+    [[nodiscard]] auto needs_ip_headers() const -> bool override {
+        return raw;
+    }
+
+    [[nodiscard]] auto queue_fd() const -> int override {
+        return socket_fd;
+    }
+};
+
+/**
+ * Counts packets as sent without transmitting them.
+ */
+class NullTransport final : public Transport {
+private:
+    SendStats send_stats{};
+
+public:
+    void send_batch([[maybe_unused]] const OutgoingPacket *packets, size_t count) override {
+        send_stats.successful += count;
+    }
+
+    void reset_stats() override {
+        send_stats = SendStats{};
+    }
+
+    [[nodiscard]] auto stats() const -> const SendStats & override {
+        return send_stats;
+    }
+
+    [[nodiscard]] auto needs_ip_headers() const -> bool override {
+        return false;
+    }
+};
+
+/**
+ * Writes packets to a pcap file with raw IPv4 link type and nanosecond timestamps.
+ */
+class PcapTransport final : public Transport {
+private:
+    FILE *file{nullptr};
+    SendStats send_stats{};
+
+public:
+    /**
+     * Create the file and write the pcap header.
+     * @param path File to write to, truncated if it exists.
+     */
+    explicit PcapTransport(const std::string &path);
+
+    ~PcapTransport() override;
+
+    void send_batch(const OutgoingPacket *packets, size_t count) override;
+
+    void flush(long timeout_us) override;
+
+    void reset_stats() override {
+        send_stats = SendStats{};
+    }
+
+    [[nodiscard]] auto stats() const -> const SendStats & override {
+        return send_stats;
+    }
+
+    [[nodiscard]] auto needs_ip_headers() const -> bool override {
+        return true;
+    }
+};
+
+/**
+ * Writes packets as Ethernet frames into a TAP device, so they arrive on it as if received from a link.
+ * Every instance opening the same device attaches its own queue with IFF_MULTI_QUEUE, which needs a device made with
+ * multi_queue or one this transport creates. Devices without it take a single instance on their only queue.
+ */
+class TapTransport final : public Transport {
+private:
+    int tap_fd{-1};
+    uint8_t ethernet_header[14]{};
+    SendStats send_stats{};
+
+public:
+    /**
+     * Attach a queue of the device, creating it if it doesn't exist, and bring the device up.
+     * Frames are addressed to the MAC address of the device.
+     * @param device Name of the TAP device.
+     */
+    explicit TapTransport(const std::string &device);
+
+    ~TapTransport() override;
+
+    void send_batch(const OutgoingPacket *packets, size_t count) override;
+
+    void reset_stats() override {
+        send_stats = SendStats{};
+    }
+
+    [[nodiscard]] auto stats() const -> const SendStats & override {
+        return send_stats;
+    }
+
+    [[nodiscard]] auto needs_ip_headers() const -> bool override {
+        return true;
+    }
+};
+
+/**
+ * Create the transport selected in the arguments.
+ * @param args Arguments to take the transport type and its settings from.
+ * @param dest_addr Address to send to.
+ * @param max_packet_size Largest packet that will be sent.
+ * @return Transport ready to send.
+ */
+auto make_transport(const struct arguments &args, const sockaddr_in &dest_addr,
+                    size_t max_packet_size) -> std::unique_ptr<Transport>;
+
+#endif //PACKET_GENERATOR_TRANSPORT_H
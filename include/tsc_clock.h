@@ -0,0 +1,90 @@
+#ifndef PACKET_GENERATOR_TSC_CLOCK_H
+#define PACKET_GENERATOR_TSC_CLOCK_H
+
+#include "constants.h"
+
+#include <cstdint>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * Cheap timestamps for the sending thread.
+ * Where the CPU has an invariant TSC that the kernel trusts as its clock source, ticks are read straight from it, which
+ * costs a fraction of a clock_gettime() call. Otherwise ticks are CLOCK_MONOTONIC nanoseconds.
+ * The tick rate is calibrated against CLOCK_MONOTONIC at startup and refined every time the clock is re-anchored,
+ * which also follows steps of CLOCK_REALTIME. Ticks are only converted to wall time when they are written out.
+ * Calibration state is owned by the sending thread: only it may re-anchor or convert ticks.
+ */
+
+extern bool tsc_enabled;
+extern double ns_per_tick;
+extern uint64_t reanchor_at_ticks;
+
+/**
+ * Pick the tick source and calibrate it. Blocks for a few milliseconds when using the TSC.
+ * Should be called on the CPU the sending thread is pinned to, if any.
+ */
+void calibrate_clock();
+
+/**
+ * Take a fresh pair of tick and clock readings to correct the tick rate and the wall clock offset.
+ * Warns once if the ticks drifted away from CLOCK_MONOTONIC, which means the TSC is not as stable as advertised.
+ */
+void reanchor_clock();
+
+/**
+ * @return Name of the tick source in use.
+ */
+auto clock_source_name() -> const char *;
+
+/**
+ * @return Current time in ticks.
+ */
+inline auto clock_ticks() -> uint64_t {
+#if defined(__x86_64__) || defined(__i386__)
+    if (tsc_enabled) {
+        return __rdtsc();
+    }
+#endif
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * S_TO_NS + (uint64_t) now.tv_nsec;
+}
+
+/**
+ * Re-anchor the clock if it was last done long enough ago. Cheap enough to call on every tick.
+ * @param now_ticks Current time in ticks.
+ */
+inline void maybe_reanchor_clock(uint64_t now_ticks) {
+    if (now_ticks >= reanchor_at_ticks) {
+        reanchor_clock();
+    }
+}
+
+/**
+ * @param ticks Time span in ticks.
+ * @return Time span in nanoseconds.
+ */
+inline auto ticks_to_ns(uint64_t ticks) -> int64_t {
+    return (int64_t) ((double) ticks * ns_per_tick);
+}
+
+/**
+ * @param ns Time span in nanoseconds.
+ * @return Time span in ticks.
+ */
+inline auto ns_to_ticks(int64_t ns) -> uint64_t {
+    return (uint64_t) ((double) ns / ns_per_tick);
+}
+
+/**
+ * Convert a tick reading to wall time, for output.
+ * @param ticks Time in ticks.
+ * @return Time in nanoseconds since the epoch on CLOCK_REALTIME.
+ */
+auto ticks_to_realtime_ns(uint64_t ticks) -> int64_t;
+
+#endif //PACKET_GENERATOR_TSC_CLOCK_H
@@ -0,0 +1,14 @@
+#ifndef PACKET_GENERATOR_VERIFIER_H
+#define PACKET_GENERATOR_VERIFIER_H
+
+/**
+ * Entry point of packet_generator --verify, which receives packets sent with --crc and checks their CRC trailers
+ * and sequence numbers, periodically printing the counts. With --arrivals, also logs when every intact packet arrived,
+ * for packet_generator --analyze to join with the sender's trace.
+ * @param argc Amount of command line arguments.
+ * @param argv Command line arguments, starting with --verify.
+ * @return Exit code: 0 if every packet checked out, 1 otherwise.
+ */
+auto verify_main(int argc, char *argv[]) -> int; // NOLINT(modernize-avoid-c-arrays) // Disabled as argv has to be of dynamic length
+
+#endif //PACKET_GENERATOR_VERIFIER_H
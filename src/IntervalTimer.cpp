@@ -1,35 +1,203 @@
 #include "constants.h"
 #include "IntervalTimer.h"
+#include "signal_handling.h"
+#include "trace.h"
+#include "tsc_clock.h"
 
+#include <algorithm>
 #include <cerrno> //errno
 #include <cstdio> //perror
 #include <cstdlib>
+#include <iostream>
 
-const itimerval stop_interval{{0, 0},
-                              {0, 0}};
+static auto clock_ns(clockid_t clock) -> int64_t {
+    timespec now{};
+    clock_gettime(clock, &now);
+    return (int64_t) now.tv_sec * S_TO_NS + now.tv_nsec;
+}
+
+auto parse_overrun_policy(const std::string &name) -> OverrunPolicy {
+    if (name == "burst") {
+        return OverrunPolicy::burst;
+    }
+    if (name == "skip") {
+        return OverrunPolicy::skip;
+    }
+    if (name == "stretch") {
+        return OverrunPolicy::stretch;
+    }
+    std::cerr << "Unknown overrun policy " << name << ", expected burst, skip or stretch." << std::endl;
+    exit(1);
+}
+
+/**
+ * Exit unless an interval is one the timer can divide lateness by and add to deadlines.
+ */
+static void check_interval(int64_t interval_ns) {
+    if (interval_ns < 1 || interval_ns > MAX_INTERVAL_NS) {
+        std::cerr << "Timer interval must be between 1 and " << MAX_INTERVAL_NS << " nanoseconds, not " << interval_ns
+                  << "." << std::endl;
+        exit(1);
+    }
+}
 
-IntervalTimer::IntervalTimer(long seconds, long microseconds, long first_unlock_us) {
-    long first_unlock_s = first_unlock_us / S_TO_US;
-    first_unlock_us -= first_unlock_s * S_TO_US;
-    this->interval = {{seconds,        microseconds},
-                      {first_unlock_s, first_unlock_us}};
+IntervalTimer::IntervalTimer(int64_t interval_ns, OverrunPolicy overrun_policy, uint32_t max_burst,
+                             int64_t first_unlock_ns) :
+        interval_ns(interval_ns), first_unlock_ns(first_unlock_ns), overrun_policy(overrun_policy),
+        max_burst(max_burst) {
+    check_interval(interval_ns);
+}
 
-    // Register alarm signal
-    sigemptyset(&alarm_signal);
-    sigaddset(&alarm_signal, SIGALRM);
+void IntervalTimer::align(clockid_t new_clock, int64_t new_grid_origin_ns) {
+    clock = new_clock;
+    aligned = true;
+    grid_origin_ns = new_grid_origin_ns;
 }
 
 void IntervalTimer::start() {
-    // Create timer: https://stackoverflow.com/questions/25327519/how-to-send-udp-packet-every-1-ms
-    if (setitimer(ITIMER_REAL, &(interval), nullptr) < 0) {
-        perror("Failed to set timer");
-        exit(errno);
+    const int64_t earliest_ns{clock_ns(clock) + first_unlock_ns};
+    if (!aligned || grid_origin_ns >= earliest_ns) {
+        next_deadline_ns = aligned ? grid_origin_ns : earliest_ns;
+    } else {
+        // Round up to the next grid point
+        const int64_t intervals{(earliest_ns - grid_origin_ns + interval_ns - 1) / interval_ns};
+        next_deadline_ns = grid_origin_ns + intervals * interval_ns;
+    }
+    start_ns = next_deadline_ns;
+}
+
+void IntervalTimer::set_interval(int64_t new_interval_ns) {
+    check_interval(new_interval_ns);
+    next_deadline_ns += new_interval_ns - interval_ns;
+    interval_ns = new_interval_ns;
+}
+
+template<bool spinning>
+auto IntervalTimer::wait_until(int64_t deadline_ns) const -> int {
+    if constexpr (!spinning) {
+        const timespec deadline{deadline_ns / S_TO_NS, deadline_ns % S_TO_NS};
+        return clock_nanosleep(clock, TIMER_ABSTIME, &deadline, nullptr);
+    }
+    if (deadline_ns - clock_ns(clock) > spin_ns) {
+        const int64_t wake_ns{deadline_ns - spin_ns};
+        const timespec wake{wake_ns / S_TO_NS, wake_ns % S_TO_NS};
+        const int error{clock_nanosleep(clock, TIMER_ABSTIME, &wake, nullptr)};
+        if (error) {
+            return error;
+        }
+    }
+    // Count the rest down in ticks, which are cheaper to read than the deadline's clock
+    const uint64_t deadline_ticks{clock_ticks() + ns_to_ticks(std::max<int64_t>(deadline_ns - clock_ns(clock), 0))};
+    while (clock_ticks() < deadline_ticks) {
+        // A spinning thread is not woken by signals, so watch for the interrupt they would deliver
+        if (keyboard_interrupt.load(std::memory_order_relaxed)) {
+            return EINTR;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#endif
     }
+    return 0;
 }
 
-void IntervalTimer::stop() {
-    if (setitimer(ITIMER_REAL, &stop_interval, nullptr) < 0) {
-        perror("Failed to stop timer");
+auto IntervalTimer::await() -> uint32_t {
+    return spinning() ? await<true, true>() : await<true, false>();
+}
+
+template<bool traced, bool spinning>
+auto IntervalTimer::await() -> uint32_t {
+    const int64_t wait_start_ns{traced && tracing() ? trace_now() : 0};
+    const int error{wait_until<spinning>(next_deadline_ns)};
+    if (error == EINTR) {
+        return 0;
+    }
+    if (error) {
+        errno = error;
+        perror("Failed to wait for timer");
         exit(errno);
     }
+
+    const int64_t now_ns{clock_ns(clock)};
+    const int64_t lateness_ns{std::max<int64_t>(now_ns - next_deadline_ns, 0)};
+    bump(pacer_stats.ticks);
+    pacer_stats.lateness.record((uint64_t) lateness_ns);
+    if constexpr (traced) {
+        trace_complete("wait", wait_start_ns, "lateness_ns", (uint64_t) lateness_ns);
+    }
+
+    // Deadlines after this one that have already passed as well
+    const uint64_t missed{(uint64_t) (lateness_ns / interval_ns)};
+    if (missed == 0) {
+        next_deadline_ns += interval_ns;
+        return 1;
+    }
+    bump(pacer_stats.missed_deadlines);
+    if (traced && tracing()) {
+        trace_instant("missed", trace_now(), "deadlines", missed);
+    }
+
+    switch (overrun_policy) {
+        case OverrunPolicy::burst: {
+            uint64_t extra{missed};
+            if (max_burst && extra + 1 > max_burst) {
+                extra = max_burst - 1;
+                bump(pacer_stats.skipped_ticks, missed - extra);
+            }
+            bump(pacer_stats.burst_packets, extra);
+            next_deadline_ns += (int64_t) (missed + 1) * interval_ns;
+            return (uint32_t) (extra + 1);
+        }
+        case OverrunPolicy::skip:
+            bump(pacer_stats.skipped_ticks, missed);
+            next_deadline_ns += (int64_t) (missed + 1) * interval_ns;
+            return 1;
+        case OverrunPolicy::stretch:
+            next_deadline_ns = now_ns + interval_ns;
+            return 1;
+    }
+    return 1;
+}
+
+template auto IntervalTimer::await<false, false>() -> uint32_t;
+template auto IntervalTimer::await<false, true>() -> uint32_t;
+template auto IntervalTimer::await<true, false>() -> uint32_t;
+template auto IntervalTimer::await<true, true>() -> uint32_t;
+
+auto IntervalTimer::await_offset(int64_t offset_ns) -> bool {
+    const int64_t deadline_ns{start_ns + offset_ns};
+    const int64_t wait_start_ns{tracing() ? trace_now() : 0};
+    const bool missed{clock_ns(clock) > deadline_ns};
+    if (missed) {
+        bump(pacer_stats.missed_deadlines);
+        if (tracing()) {
+            trace_instant("missed", wait_start_ns, "deadlines", 1);
+        }
+    } else {
+        const int error{spinning() ? wait_until<true>(deadline_ns) : wait_until<false>(deadline_ns)};
+        if (error == EINTR) {
+            return false;
+        }
+        if (error) {
+            errno = error;
+            perror("Failed to wait for timer");
+            exit(errno);
+        }
+    }
+
+    const int64_t lateness_ns{std::max<int64_t>(clock_ns(clock) - deadline_ns, 0)};
+    bump(pacer_stats.ticks);
+    pacer_stats.lateness.record((uint64_t) lateness_ns);
+    trace_complete("wait", wait_start_ns, "lateness_ns", (uint64_t) lateness_ns);
+    if (missed && overrun_policy == OverrunPolicy::stretch) {
+        start_ns += lateness_ns;
+    }
+    return true;
+}
+
+void IntervalTimer::reset_stats() {
+    pacer_stats.ticks.store(0, std::memory_order_relaxed);
+    pacer_stats.missed_deadlines.store(0, std::memory_order_relaxed);
+    pacer_stats.skipped_ticks.store(0, std::memory_order_relaxed);
+    pacer_stats.burst_packets.store(0, std::memory_order_relaxed);
+    pacer_stats.lateness.reset();
 }
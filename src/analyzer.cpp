@@ -0,0 +1,555 @@
+#include "analyzer.h"
+#include "argparse.h"
+#include "constants.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno> //errno
+#include <cmath>
+#include <cstdio> //perror
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Percentiles printed for every distribution, the first and last being the minimum and maximum
+const std::vector<double> printed_fractions{0, 0.5, 0.9, 0.99, 0.999, 1};
+// Shortest line in a trace, to size the records parsed from a chunk up front
+const size_t min_line_bytes{24};
+
+/**
+ * A packet as logged by the sender with --csv.
+ */
+struct Departure {
+    uint32_t packet_num;
+    int64_t pre_send_ns;
+    int64_t post_send_ns;
+};
+
+/**
+ * A packet as logged by packet_generator --verify --arrivals.
+ */
+struct Arrival {
+    uint8_t label;
+    uint32_t packet_num;
+    int64_t arrival_ns;
+};
+
+/**
+ * A trace file mapped read-only into memory.
+ */
+class MappedTrace {
+private:
+    const char *data{nullptr};
+    size_t length{0};
+
+public:
+    explicit MappedTrace(const std::string &path) {
+        const int fd{open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+        if (fd < 0) {
+            perror(("Can't open " + path).c_str());
+            exit(errno);
+        }
+        struct stat status{};
+        if (fstat(fd, &status) < 0) {
+            perror("Can't read trace size");
+            exit(errno);
+        }
+        length = (size_t) status.st_size;
+        if (length > 0) {
+            void *mapping{mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0)};
+            if (mapping == MAP_FAILED) {
+                perror("Can't map trace");
+                exit(errno);
+            }
+            // Every thread reads its own chunk front to back
+            madvise(mapping, length, MADV_SEQUENTIAL);
+            data = (const char *) mapping;
+        }
+        close(fd);
+    }
+
+    MappedTrace(const MappedTrace &) = delete;
+
+    auto operator=(const MappedTrace &) -> MappedTrace & = delete;
+
+    ~MappedTrace() {
+        if (data != nullptr) {
+            munmap((void *) data, length);
+        }
+    }
+
+    [[nodiscard]] auto begin() const -> const char * {
+        return data;
+    }
+
+    [[nodiscard]] auto end() const -> const char * {
+        return data + length;
+    }
+};
+
+static auto parse_number(const char *&cursor, const char *end, uint64_t &value) -> bool {
+    const char *start{cursor};
+    value = 0;
+    while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+        value = value * 10 + (uint64_t) (*cursor - '0');
+        cursor++;
+    }
+    return cursor != start;
+}
+
+/**
+ * Parse a decimal number of seconds into nanoseconds, without going through floating point.
+ */
+static auto parse_seconds(const char *&cursor, const char *end, int64_t &value_ns) -> bool {
+    uint64_t whole;
+    if (!parse_number(cursor, end, whole)) {
+        return false;
+    }
+    int64_t fraction_ns{0};
+    if (cursor < end && *cursor == '.') {
+        cursor++;
+        int64_t digit_ns{S_TO_NS / 10};
+        while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+            fraction_ns += (*cursor - '0') * digit_ns;
+            digit_ns /= 10;
+            cursor++;
+        }
+    }
+    value_ns = (int64_t) whole * S_TO_NS + fraction_ns;
+    return true;
+}
+
+static auto parse_separator(const char *&cursor, const char *end) -> bool {
+    while (cursor < end && *cursor == ' ') {
+        cursor++;
+    }
+    if (cursor == end || *cursor != ',') {
+        return false;
+    }
+    cursor++;
+    while (cursor < end && *cursor == ' ') {
+        cursor++;
+    }
+    return true;
+}
+
+static auto parse_line_end(const char *cursor, const char *end) -> bool {
+    return cursor == end || *cursor == '\r';
+}
+
+/**
+ * Parse a "packet_num, pre_send_s, post_send_s" line.
+ */
+static auto parse_departure(const char *cursor, const char *end, Departure &res) -> bool {
+    uint64_t packet_num;
+    if (!parse_number(cursor, end, packet_num) || packet_num > UINT32_MAX || !parse_separator(cursor, end) ||
+        !parse_seconds(cursor, end, res.pre_send_ns) || !parse_separator(cursor, end) ||
+        !parse_seconds(cursor, end, res.post_send_ns)) {
+        return false;
+    }
+    res.packet_num = (uint32_t) packet_num;
+    return parse_line_end(cursor, end);
+}
+
+/**
+ * Parse a "label, packet_num, arrival_s" line.
+ */
+static auto parse_arrival(const char *cursor, const char *end, Arrival &res) -> bool {
+    uint64_t label;
+    uint64_t packet_num;
+    if (!parse_number(cursor, end, label) || label > UINT8_MAX || !parse_separator(cursor, end) ||
+        !parse_number(cursor, end, packet_num) || packet_num > UINT32_MAX || !parse_separator(cursor, end) ||
+        !parse_seconds(cursor, end, res.arrival_ns)) {
+        return false;
+    }
+    res.label = (uint8_t) label;
+    res.packet_num = (uint32_t) packet_num;
+    return parse_line_end(cursor, end);
+}
+
+/**
+ * Run a function over a range split evenly across threads.
+ * @param count Size of the range.
+ * @param threads Amount of threads.
+ * @param body Called with the thread index and the start and end of its part.
+ */
+template<typename Body>
+static void parallel_for(size_t count, unsigned int threads, Body body) {
+    std::vector<std::thread> workers;
+    for (unsigned int thread = 0; thread < threads; thread++) {
+        workers.emplace_back(body, thread, count * thread / threads, count * (thread + 1) / threads);
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+}
+
+/**
+ * Parse every line of a trace, with each thread taking a chunk that starts and ends on a line boundary.
+ * @param trace Mapped trace.
+ * @param threads Amount of threads.
+ * @param parse Parses a line without its newline into a record, returning false for lines of another format.
+ * @param skipped Incremented by the amount of lines that did not parse, such as the report at the end of a run.
+ * @return Records in the order of the trace.
+ */
+template<typename Record, typename Parser>
+static auto parse_trace(const MappedTrace &trace, unsigned int threads, Parser parse,
+                        uint64_t &skipped) -> std::vector<Record> {
+    const size_t length{(size_t) (trace.end() - trace.begin())};
+    // A chunk starts after the first newline at or past its even share, both for its own start and its predecessor's end
+    const auto boundary{[&](size_t chunk) -> const char * {
+        if (chunk == 0 || chunk == threads) {
+            return chunk == 0 ? trace.begin() : trace.end();
+        }
+        const char *at{trace.begin() + length * chunk / threads};
+        const auto *newline{(const char *) memchr(at, '\n', (size_t) (trace.end() - at))};
+        return newline == nullptr ? trace.end() : newline + 1;
+    }};
+
+    std::vector<std::vector<Record>> parts(threads);
+    std::vector<uint64_t> parts_skipped(threads);
+    parallel_for(threads, threads, [&](unsigned int thread, size_t, size_t) {
+        const char *line{boundary(thread)};
+        const char *chunk_end{boundary(thread + 1)};
+        std::vector<Record> &part{parts[thread]};
+        part.reserve((size_t) (chunk_end - line) / min_line_bytes);
+        while (line < chunk_end) {
+            const auto *newline{(const char *) memchr(line, '\n', (size_t) (chunk_end - line))};
+            const char *line_end{newline == nullptr ? chunk_end : newline};
+            Record record{};
+            if (parse(line, line_end, record)) {
+                part.push_back(record);
+            } else if (line_end != line) {
+                parts_skipped[thread]++;
+            }
+            line = line_end + 1;
+        }
+    });
+
+    size_t total{0};
+    for (const auto &part: parts) {
+        total += part.size();
+    }
+    std::vector<Record> res;
+    res.reserve(total);
+    for (unsigned int thread = 0; thread < threads; thread++) {
+        res.insert(res.end(), parts[thread].begin(), parts[thread].end());
+        parts[thread] = std::vector<Record>{};
+        skipped += parts_skipped[thread];
+    }
+    return res;
+}
+
+/**
+ * Pick percentiles out of values in linear time, reordering them.
+ * @param values Values to pick from, not empty.
+ * @param fractions Fractions between 0 and 1, in increasing order.
+ * @return Value at each fraction.
+ */
+static auto percentiles(std::vector<int64_t> &values, const std::vector<double> &fractions) -> std::vector<int64_t> {
+    std::vector<int64_t> res;
+    auto from{values.begin()};
+    for (const double fraction: fractions) {
+        const auto rank{(size_t) std::max(std::ceil(fraction * (double) values.size()) - 1, 0.0)};
+        const auto nth{values.begin() + (ptrdiff_t) std::min(rank, values.size() - 1)};
+        // Everything before the previous percentile is known to be smaller
+        std::nth_element(from, nth, values.end());
+        res.push_back(*nth);
+        from = nth;
+    }
+    return res;
+}
+
+static void print_distribution(const char *name, std::vector<int64_t> &values_ns) {
+    const std::vector<int64_t> picked{percentiles(values_ns, printed_fractions)};
+    std::cout << name << ": min " << (double) picked[0] / 1000 << "us, median " << (double) picked[1] / 1000
+              << "us, 90th " << (double) picked[2] / 1000 << "us, 99th " << (double) picked[3] / 1000
+              << "us, 99.9th " << (double) picked[4] / 1000 << "us, max " << (double) picked[5] / 1000 << "us."
+              << std::endl;
+}
+
+auto analyze_main(int argc, char *argv[]) -> int { // NOLINT(modernize-avoid-c-arrays) // Disabled as argv has to be of dynamic length
+    argparse::ArgumentParser parser("Packet Generator");
+    parser.add_description(
+            "Analyze a sender trace written with --csv, and optionally join it with an arrival trace written by "
+            "packet_generator --verify --arrivals.");
+    parser.add_argument("--analyze").help("Sender trace").required();
+    parser.add_argument("--arrivals").help("Arrival trace to join by label and sequence number").nargs(
+            1).default_value((std::string) "");
+    parser.add_argument("-l", "--label").help("Label the sender trace was sent with").nargs(1).default_value(
+            (uint8_t) 0).scan<'u', uint8_t>();
+    parser.add_argument("--threads").help("Threads to parse and analyze with. If omitted or 0, one per CPU.").nargs(
+            1).default_value((unsigned int) 0).scan<'u', unsigned int>();
+    parser.add_argument("--bin-ms").help("Width of the bins the rate over time is counted in, in milliseconds").nargs(
+            1).default_value((unsigned int) 1000).scan<'u', unsigned int>();
+    parser.add_argument("--gap-factor").help(
+            "Inter-departure times longer than this many median intervals count as gaps").nargs(1).default_value(
+            2.0).scan<'g', double>();
+    parser.add_argument("--burst-factor").help(
+            "Inter-departure times shorter than this many median intervals join packets into bursts").nargs(
+            1).default_value(0.5).scan<'g', double>();
+    parser.add_argument("--series").help(
+            "CSV file to write departures, arrivals and mean one-way delay per bin to").nargs(1).default_value(
+            (std::string) "");
+    parser.add_argument("--delays").help("CSV file to write the one-way delay of every arrived packet to").nargs(
+            1).default_value((std::string) "");
+    try {
+        parser.parse_args(argc, argv);
+    } catch (const std::runtime_error &err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << parser;
+        std::exit(1);
+    }
+    const auto label_byte{parser.get<uint8_t>("--label")};
+    const unsigned int threads{parser.get<unsigned int>("--threads") > 0 ? parser.get<unsigned int>("--threads")
+                                                                         : std::max(1U, std::thread::hardware_concurrency())};
+    const int64_t bin_ns{(int64_t) parser.get<unsigned int>("--bin-ms") * (S_TO_NS / 1000)};
+    const double gap_factor{parser.get<double>("--gap-factor")};
+    const double burst_factor{parser.get<double>("--burst-factor")};
+    const std::string arrivals_path{parser.get("--arrivals")};
+    const std::string series_path{parser.get("--series")};
+    const std::string delays_path{parser.get("--delays")};
+    if (bin_ns <= 0) {
+        std::cerr << "Bins must be at least a millisecond wide." << std::endl;
+        std::exit(1);
+    }
+
+    uint64_t skipped{0};
+    std::vector<Departure> departures;
+    {
+        const MappedTrace trace{parser.get("--analyze")};
+        departures = parse_trace<Departure>(trace, threads, parse_departure, skipped);
+    }
+    if (departures.size() < 2) {
+        std::cerr << "The sender trace holds fewer than two packets." << std::endl;
+        std::exit(1);
+    }
+    const size_t sent{departures.size()};
+    const int64_t first_ns{departures.front().pre_send_ns};
+    const double span_s{(double) (departures.back().pre_send_ns - first_ns) / S_TO_NS};
+    std::cout << "Sender trace: " << sent << " packets over " << span_s << " seconds, " << (double) (sent - 1) / span_s
+              << "Hz on average";
+    if (skipped > 0) {
+        std::cout << ", skipped " << skipped << " other lines";
+    }
+    std::cout << "." << std::endl;
+
+    // Inter-departure times, send call durations and departures per bin, in parallel
+    const size_t bins{(size_t) ((departures.back().pre_send_ns - first_ns) / bin_ns) + 1};
+    std::vector<int64_t> gaps_ns(sent - 1);
+    std::vector<int64_t> send_ns(sent);
+    std::vector<std::vector<uint64_t>> parts_sent_per_bin(threads);
+    parallel_for(sent, threads, [&](unsigned int thread, size_t begin, size_t end) {
+        std::vector<uint64_t> &sent_per_bin{parts_sent_per_bin[thread]};
+        sent_per_bin.assign(bins, 0);
+        for (size_t i = begin; i < end; i++) {
+            const Departure &departure{departures[i]};
+            if (i + 1 < sent) {
+                gaps_ns[i] = departures[i + 1].pre_send_ns - departure.pre_send_ns;
+            }
+            send_ns[i] = departure.post_send_ns - departure.pre_send_ns;
+            sent_per_bin[(size_t) std::clamp<int64_t>((departure.pre_send_ns - first_ns) / bin_ns, 0,
+                                                      (int64_t) bins - 1)]++;
+        }
+    });
+    std::vector<uint64_t> sent_per_bin(bins);
+    for (const auto &part: parts_sent_per_bin) {
+        for (size_t bin = 0; bin < bins; bin++) {
+            sent_per_bin[bin] += part[bin];
+        }
+    }
+
+    // Gaps and bursts are judged against the median interval, in trace order before the times are reordered
+    std::vector<int64_t> sorted_gaps_ns{gaps_ns};
+    const int64_t median_ns{percentiles(sorted_gaps_ns, {0.5})[0]};
+    const auto gap_threshold_ns{(int64_t) (gap_factor * (double) median_ns)};
+    const auto burst_threshold_ns{(int64_t) (burst_factor * (double) median_ns)};
+    uint64_t gaps{0};
+    int64_t gap_time_ns{0};
+    size_t largest_gap{0};
+    uint64_t bursts{0};
+    uint64_t burst_length{1};
+    uint64_t largest_burst{0};
+    double sum_ns{0};
+    double sum_squares_ns{0};
+    for (size_t i = 0; i < gaps_ns.size(); i++) {
+        const int64_t gap_ns{gaps_ns[i]};
+        sum_ns += (double) gap_ns;
+        sum_squares_ns += (double) gap_ns * (double) gap_ns;
+        if (gap_ns > gap_threshold_ns) {
+            gaps++;
+            gap_time_ns += gap_ns - median_ns;
+            if (gap_ns > gaps_ns[largest_gap]) {
+                largest_gap = i;
+            }
+        }
+        if (gap_ns < burst_threshold_ns) {
+            bursts += burst_length == 1;
+            burst_length++;
+            largest_burst = std::max(largest_burst, burst_length);
+        } else {
+            burst_length = 1;
+        }
+    }
+    const double mean_ns{sum_ns / (double) gaps_ns.size()};
+    const double deviation_ns{std::sqrt(std::max(sum_squares_ns / (double) gaps_ns.size() - mean_ns * mean_ns, 0.0))};
+
+    print_distribution("Inter-departure time", sorted_gaps_ns);
+    std::cout << "Inter-departure jitter: mean " << mean_ns / 1000 << "us, standard deviation " << deviation_ns / 1000
+              << "us." << std::endl;
+    print_distribution("Send call duration", send_ns);
+    std::cout << "Gaps over " << gap_factor << " median intervals: " << gaps << ", adding up to "
+              << (double) gap_time_ns / 1000 << "us";
+    if (gaps > 0) {
+        std::cout << ", the longest " << (double) gaps_ns[largest_gap] / 1000 << "us after packet "
+                  << departures[largest_gap].packet_num;
+    }
+    std::cout << "." << std::endl << "Bursts under " << burst_factor << " median intervals: " << bursts
+              << ", the largest " << largest_burst << " packets." << std::endl;
+    if (bins > 2) {
+        // The last bin is only partly covered
+        std::vector<int64_t> rates(sent_per_bin.begin(), sent_per_bin.end() - 1);
+        const std::vector<int64_t> picked{percentiles(rates, {0, 0.5, 1})};
+        const double per_second{(double) S_TO_NS / (double) bin_ns};
+        std::cout << "Rate over " << bin_ns / (S_TO_NS / 1000) << "ms bins: min " << (double) picked[0] * per_second
+                  << "Hz, median " << (double) picked[1] * per_second << "Hz, max " << (double) picked[2] * per_second
+                  << "Hz." << std::endl;
+    }
+
+    std::vector<uint64_t> arrived_per_bin(bins);
+    std::vector<double> delay_sum_per_bin(bins);
+    if (!arrivals_path.empty()) {
+        uint64_t arrivals_skipped{0};
+        std::vector<Arrival> arrivals;
+        {
+            const MappedTrace trace{arrivals_path};
+            arrivals = parse_trace<Arrival>(trace, threads, parse_arrival, arrivals_skipped);
+        }
+
+        // Departure times by sequence number, for the arrivals to look themselves up in
+        uint32_t max_packet_num{0};
+        for (const auto &departure: departures) {
+            max_packet_num = std::max(max_packet_num, departure.packet_num);
+        }
+        std::vector<int64_t> sent_at((size_t) max_packet_num + 1, INT64_MIN);
+        for (const auto &departure: departures) {
+            sent_at[departure.packet_num] = departure.pre_send_ns;
+        }
+        const std::unique_ptr<std::atomic<uint8_t>[]> arrived{new std::atomic<uint8_t>[(size_t) max_packet_num + 1]()};
+
+        struct JoinPart {
+            uint64_t matched{0};
+            uint64_t unmatched{0};
+            uint64_t duplicates{0};
+            std::vector<int64_t> delays_ns;
+            std::vector<uint32_t> packet_nums;
+            std::vector<uint64_t> arrived_per_bin;
+            std::vector<double> delay_sum_per_bin;
+        };
+        std::vector<JoinPart> parts(threads);
+        parallel_for(arrivals.size(), threads, [&](unsigned int thread, size_t begin, size_t end) {
+            JoinPart &part{parts[thread]};
+            part.arrived_per_bin.assign(bins, 0);
+            part.delay_sum_per_bin.assign(bins, 0);
+            part.delays_ns.reserve(end - begin);
+            part.packet_nums.reserve(end - begin);
+            for (size_t i = begin; i < end; i++) {
+                const Arrival &arrival{arrivals[i]};
+                if (arrival.label != label_byte) {
+                    continue;
+                }
+                if (arrival.packet_num > max_packet_num || sent_at[arrival.packet_num] == INT64_MIN) {
+                    part.unmatched++;
+                    continue;
+                }
+                if (arrived[arrival.packet_num].exchange(1, std::memory_order_relaxed)) {
+                    part.duplicates++;
+                    continue;
+                }
+                part.matched++;
+                const int64_t delay_ns{arrival.arrival_ns - sent_at[arrival.packet_num]};
+                part.delays_ns.push_back(delay_ns);
+                part.packet_nums.push_back(arrival.packet_num);
+                const auto bin{(size_t) std::clamp<int64_t>((sent_at[arrival.packet_num] - first_ns) / bin_ns, 0,
+                                                            (int64_t) bins - 1)};
+                part.arrived_per_bin[bin]++;
+                part.delay_sum_per_bin[bin] += (double) delay_ns;
+            }
+        });
+        std::vector<uint64_t> parts_lost(threads);
+        parallel_for(sent, threads, [&](unsigned int thread, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                parts_lost[thread] += arrived[departures[i].packet_num].load(std::memory_order_relaxed) == 0;
+            }
+        });
+
+        uint64_t matched{0};
+        uint64_t unmatched{0};
+        uint64_t duplicates{0};
+        uint64_t lost{0};
+        std::vector<int64_t> delays_ns;
+        delays_ns.reserve(arrivals.size());
+        for (unsigned int thread = 0; thread < threads; thread++) {
+            const JoinPart &part{parts[thread]};
+            matched += part.matched;
+            unmatched += part.unmatched;
+            duplicates += part.duplicates;
+            lost += parts_lost[thread];
+            delays_ns.insert(delays_ns.end(), part.delays_ns.begin(), part.delays_ns.end());
+            for (size_t bin = 0; bin < bins; bin++) {
+                arrived_per_bin[bin] += part.arrived_per_bin[bin];
+                delay_sum_per_bin[bin] += part.delay_sum_per_bin[bin];
+            }
+        }
+
+        if (!delays_path.empty()) {
+            std::ofstream delays_file{delays_path};
+            if (!delays_file) {
+                perror("Can't open delays file");
+                exit(errno);
+            }
+            delays_file << "packet_num, one_way_delay_ns\n";
+            for (const auto &part: parts) {
+                for (size_t i = 0; i < part.packet_nums.size(); i++) {
+                    delays_file << part.packet_nums[i] << ", " << part.delays_ns[i] << '\n';
+                }
+            }
+        }
+
+        std::cout << "Arrival trace: " << matched << " of the sent packets arrived, " << lost << " ("
+                  << (double) lost * 100 / (double) sent << "%) were lost, " << duplicates << " arrived again and "
+                  << unmatched << " were not in the sender trace";
+        if (arrivals_skipped > 0) {
+            std::cout << ", skipped " << arrivals_skipped << " other lines";
+        }
+        std::cout << "." << std::endl;
+        if (!delays_ns.empty()) {
+            // Across hosts this includes the offset between their clocks
+            print_distribution("One-way delay", delays_ns);
+        }
+    }
+
+    if (!series_path.empty()) {
+        std::ofstream series_file{series_path};
+        if (!series_file) {
+            perror("Can't open series file");
+            exit(errno);
+        }
+        series_file << std::fixed << "time_s, departures, arrivals, mean_one_way_delay_us\n";
+        for (size_t bin = 0; bin < bins; bin++) {
+            series_file << (double) ((int64_t) bin * bin_ns) / S_TO_NS << ", " << sent_per_bin[bin] << ", "
+                        << arrived_per_bin[bin] << ", "
+                        << (arrived_per_bin[bin] ? delay_sum_per_bin[bin] / (double) arrived_per_bin[bin] / 1000 : 0)
+                        << '\n';
+        }
+    }
+    return 0;
+}
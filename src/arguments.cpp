@@ -0,0 +1,512 @@
+#include "arguments.h"
+#include "argparse.h"
+#include "constants.h"
+#include "live_stats.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+/**
+ * Split a comma separated list.
+ */
+static auto split_list(const std::string &list) -> std::vector<std::string> {
+    std::vector<std::string> items;
+    std::stringstream stream{list};
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        items.push_back(item);
+    }
+    return items;
+}
+
+/**
+ * Parse a comma separated list of numbers.
+ * @param what Name of the items, for error messages.
+ */
+static auto parse_numbers(const std::string &list, const std::string &what) -> std::vector<unsigned int> {
+    std::vector<unsigned int> numbers;
+    for (const std::string &item: split_list(list)) {
+        try {
+            numbers.push_back((unsigned int) std::stoul(item));
+        } catch (const std::logic_error &) {
+            std::cerr << "Invalid " << what << " " << item << " in " << list << "." << std::endl;
+            std::exit(1);
+        }
+    }
+    return numbers;
+}
+
+/**
+ * Parse the name of a clock to align the schedule to.
+ */
+static auto parse_clock(const std::string &name) -> clockid_t {
+    if (name == "realtime") {
+        return CLOCK_REALTIME;
+    }
+    if (name == "tai") {
+        return CLOCK_TAI;
+    }
+    std::cerr << "Unknown clock " << name << ", expected realtime or tai." << std::endl;
+    std::exit(1);
+}
+
+auto parse_args(int argc,
+                char *argv[]) -> struct arguments { // NOLINT(modernize-avoid-c-arrays) // Disabled as argv has to be of dynamic length
+    // Register arguments
+    argparse::ArgumentParser parser("Packet Generator");
+    parser.add_description("Send UDP packets to a destination at a specific frequency.\n"
+                           "Packet structure:\n"
+                           "Label byte               (1B)\n"
+                           "Packet sequence number   (4B)\n"
+                           "Padding zero bytes       (remaining bytes)");
+    parser.add_argument("dest_IP").help("IPv4 address to send packets to");
+    parser.add_argument("dest_port").help("Port to send packets to").scan<'u', unsigned int>();
+    parser.add_argument("packet_freq").help("Frequency in Hz to send packets").scan<'f', double>();
+    parser.add_argument("packet_size").help("Size of packet payload in bytes").scan<'u', unsigned int>();
+    parser.add_argument("packet_dscp").help(
+            "IP DSCP code for packet, see https://www.speedguide.net/articles/quality-of-service-tos-dscp-wmm-3477").scan<'u', uint8_t>();
+    parser.add_argument("-t", "--timeout").help(
+            "Timeout to send packets for in whole seconds. If omitted or 0, runs indefinitely.").nargs(1).default_value(
+            (unsigned int) 0).scan<'u', unsigned int>();
+    parser.add_argument("-v", "--verbose").help("Print debugging information").default_value(false).implicit_value(
+            true);
+    parser.add_argument("-i", "--interface").help("Interface to send packets over").nargs(1).default_value(
+            (std::string) "");
+    parser.add_argument("-l", "--label").help("Byte to label transmissions with").nargs(1).default_value(
+            (uint8_t) 0).scan<'u', uint8_t>();
+    parser.add_argument("-c", "--csv").help("Output packet start and end times in csv format").default_value(
+            false).implicit_value(true);
+    parser.add_argument("-r", "--raw").help(
+            "Send over a raw socket, building the IP and UDP headers in user space. Requires root.").default_value(
+            false).implicit_value(true);
+    parser.add_argument("--src-ip").help(
+            "First source IPv4 address in raw mode. If omitted, the address the kernel would route from is used.").nargs(
+            1).default_value((std::string) "");
+    parser.add_argument("--src-ip-count").help("Amount of consecutive source addresses to rotate over in raw mode").nargs(
+            1).default_value((unsigned int) 1).scan<'u', unsigned int>();
+    parser.add_argument("--src-port").help("First source port in raw mode").nargs(1).default_value(
+            (unsigned int) 49152).scan<'u', unsigned int>();
+    parser.add_argument("--src-port-count").help("Amount of consecutive source ports to rotate over in raw mode").nargs(
+            1).default_value((unsigned int) 1).scan<'u', unsigned int>();
+    parser.add_argument("-b", "--backpressure").help(
+            "What to do when the socket buffer is full: drop the packet, queue it for retrying once the socket is "
+            "writable, or block until writable up to a deadline").nargs(1).default_value((std::string) "drop");
+    parser.add_argument("--retry-queue-size").help("Amount of packets held for retrying with --backpressure queue").nargs(
+            1).default_value((unsigned int) 1024).scan<'u', unsigned int>();
+    parser.add_argument("--block-deadline").help(
+            "Longest time to wait for a full socket buffer with --backpressure block, in microseconds").nargs(
+            1).default_value((unsigned int) 1000).scan<'u', unsigned int>();
+    parser.add_argument("-o", "--overrun").help(
+            "What to do with deadlines missed while the sender was busy: burst to catch up and keep the average "
+            "rate, skip them to keep the phase, or stretch the schedule").nargs(1).default_value((std::string) "skip");
+    parser.add_argument("--max-burst").help(
+            "Most packets to send at once when catching up with --overrun burst, 0 for unlimited").nargs(
+            1).default_value((unsigned int) 0).scan<'u', unsigned int>();
+    parser.add_argument("-q", "--quiet").help("Do not print a line for every packet").default_value(
+            false).implicit_value(true);
+    parser.add_argument("--benchmark").help(
+            "Comma separated packet sizes to search the highest lossless rate for, up to packet_freq, instead of "
+            "sending at a fixed rate. Loss is measured by a receiver on this host listening on dest_port.").nargs(
+            1).default_value((std::string) "");
+    parser.add_argument("--trial-length").help("Length of each benchmark trial in whole seconds").nargs(
+            1).default_value((unsigned int) 10).scan<'u', unsigned int>();
+    parser.add_argument("--tolerance").help(
+            "Stop the benchmark search once the rate is known to within this fraction").nargs(1).default_value(
+            0.01).scan<'g', double>();
+    parser.add_argument("--loss-ratio").help("Highest fraction of packets a benchmark trial may lose to pass").nargs(
+            1).default_value(0.0).scan<'g', double>();
+    parser.add_argument("-T", "--transport").help(
+            "Where to send packets: socket to the destination, null to discard them without a system call, "
+            "loopback to send to dest_port on this host, pcap to write them to --pcap-file, tap to write them as Ethernet "
+            "frames into the TAP device named by --interface, which needs to be made with multi_queue for several "
+            "--instances, dpdk to transmit them on a DPDK port in builds made with make dpdk, or tcp to stream bulk "
+            "data to dest_IP:dest_port over TCP instead").nargs(
+            1).default_value((std::string) "socket");
+    parser.add_argument("--pcap-file").help("File to write packets to with --transport pcap").nargs(
+            1).default_value((std::string) "packets.pcap");
+    parser.add_argument("--perf").help(
+            "Count cycles, instructions, cache misses, context switches and page faults on the sending thread and "
+            "report them per packet").default_value(false).implicit_value(true);
+    parser.add_argument("--shm").help(
+            "Publish live counters in shared memory for packet_generator --attach <pid>").default_value(
+            false).implicit_value(true);
+    parser.add_argument("--shm-name").help(
+            "Name of the shared memory segment to publish live counters in, implies --shm. If omitted, "
+            "/packet_generator.<pid> is used.").nargs(1).default_value((std::string) "");
+    parser.add_argument("--control").help(
+            "UNIX socket to accept commands on that change the rate, packet size and DSCP, pause and resume sending, "
+            "or query statistics while running").nargs(1).default_value((std::string) "");
+
+    parser.add_argument("--start-at").help(
+            "Time of the first departure in nanoseconds since the epoch on --clock. Later departures lie on a grid "
+            "of whole intervals from it, so instances started with the same value send in step. If it has passed, "
+            "sending starts at the next grid point.").nargs(1).default_value((long long) 0).scan<'d', long long>();
+    parser.add_argument("--phase-offset").help(
+            "Nanoseconds to shift the departure grid by, to interleave instances sharing a --start-at. Without "
+            "--start-at, the grid starts at the epoch.").nargs(1).default_value((long long) 0).scan<'d', long long>();
+    parser.add_argument("--clock").help(
+            "Clock --start-at and --phase-offset refer to: realtime, or tai to be immune to leap seconds. tai is only "
+            "correct if the time daemon has set the kernel's TAI offset.").nargs(1).default_value(
+            (std::string) "realtime");
+
+    parser.add_argument("-n", "--instances").help(
+            "Amount of generator processes to fork, each sending an equal share of packet_freq, interleaved in time. "
+            "Their counters are combined into a single report.").nargs(1).default_value((unsigned int) 1).scan<'u',
+            unsigned int>();
+    parser.add_argument("--cpus").help(
+            "Comma separated CPUs to pin the sending threads to, one per instance, reused round robin").nargs(
+            1).default_value((std::string) "");
+    parser.add_argument("--interfaces").help(
+            "Comma separated interfaces to send over, one per instance, reused round robin. Overrides "
+            "--interface.").nargs(1).default_value((std::string) "");
+
+    parser.add_argument("--rt").help(
+            "Real-time profile: pin the sending thread to the first of --cpus or the current CPU, lock all memory, "
+            "allocate packet buffers from huge pages and fault everything in before sending").default_value(
+            false).implicit_value(true);
+
+    parser.add_argument("--warmup").help(
+            "Longest time in seconds to warm up for before counting, ending early once wake lateness settles. "
+            "Warm-up and steady state are reported separately.").nargs(1).default_value(0.0).scan<'g', double>();
+    parser.add_argument("--warmup-mode").help(
+            "Send probe packets with sequence number 0 during the warm-up, or only run the pacer silently").nargs(
+            1).default_value((std::string) "probe");
+
+    parser.add_argument("--trace").help(
+            "Record pacer, send, event loop and receiver activity of every thread and write it to this file in Chrome "
+            "trace JSON at exit, for viewing in Perfetto or chrome://tracing").nargs(1).default_value(
+            (std::string) "");
+    parser.add_argument("--trace-events").help(
+            "Events to preallocate per traced thread, later events are dropped").nargs(1).default_value(
+            (unsigned int) 262144).scan<'u', unsigned int>();
+    parser.add_argument("--replay").help(
+            "pcap or pcapng file to resend the UDP payloads of to dest_IP:dest_port, at the gaps they were captured "
+            "with, instead of generating packets").nargs(1).default_value((std::string) "");
+    parser.add_argument("--replay-speed").help(
+            "Factor to speed up replayed gaps by, 2 sends twice as fast").nargs(1).default_value(1.0).scan<'g', double>();
+    parser.add_argument("--replay-fixed-rate").help(
+            "Replay at packet_freq rather than at the captured gaps").default_value(false).implicit_value(true);
+    parser.add_argument("--payload").help(
+            "What to fill packets with after the sequence number: zero bytes, seeded pseudo-random bytes, an "
+            "incrementing pattern, or slices of --payload-file").nargs(1).default_value((std::string) "zero");
+    parser.add_argument("--payload-seed").help("Seed for --payload random").nargs(1).default_value(
+            (unsigned long long) 1).scan<'u', unsigned long long>();
+    parser.add_argument("--payload-file").help("File to slice payloads from, implies --payload file").nargs(
+            1).default_value((std::string) "");
+    parser.add_argument("--payload-pool").help(
+            "Packet buffers to fill up front and rotate over, so that consecutive packets differ").nargs(
+            1).default_value((unsigned int) 256).scan<'u', unsigned int>();
+    parser.add_argument("--tcp-file").help(
+            "File to stream with --transport tcp, preferably on tmpfs. If omitted, a memfd filled with --payload is "
+            "used.").nargs(1).default_value((std::string) "");
+    parser.add_argument("--pacing-rate").help(
+            "Highest rate the kernel paces a --transport tcp stream to, in Mbit/s. If omitted or 0, unpaced.").nargs(
+            1).default_value(0.0).scan<'g', double>();
+    parser.add_argument("--sample-queues").help(
+            "Milliseconds between samples of the socket send queue, and the root qdisc and driver drops of "
+            "--interface, to tell which of them sends failed in. If omitted or 0, not sampled.").nargs(
+            1).default_value((unsigned int) 0).scan<'u', unsigned int>();
+    parser.add_argument("--queue-log").help(
+            "CSV file to write every queue sample to, implies --sample-queues 100 if that is not given").nargs(
+            1).default_value((std::string) "");
+    parser.add_argument("--spin-us").help(
+            "Microseconds before each deadline to spin on the tick clock rather than sleep, trading a busy CPU for "
+            "wakeup precision. --transport dpdk spins for the whole interval unless this is given.").nargs(
+            1).default_value((unsigned int) 0).scan<'u', unsigned int>();
+#ifdef PACKET_GENERATOR_DPDK
+    parser.add_argument("--dpdk-eal").help(
+            "Space separated arguments for the DPDK environment abstraction layer with --transport dpdk, such as "
+            "\"--no-huge --no-pci --vdev=net_null0\"").nargs(1).default_value((std::string) "");
+    parser.add_argument("--dpdk-port").help("DPDK port to transmit on with --transport dpdk").nargs(
+            1).default_value((uint16_t) 0).scan<'u', uint16_t>();
+    parser.add_argument("--dpdk-dest-mac").help("Destination MAC address of frames sent with --transport dpdk").nargs(
+            1).default_value((std::string) "ff:ff:ff:ff:ff:ff");
+#endif
+    parser.add_argument("--crc").help(
+            "End every packet with a CRC32C of its contents, for packet_generator --verify to check").default_value(
+            false).implicit_value(true);
+
+    // Attempt to parse the arguments provided
+    try {
+        parser.parse_args(argc, argv);
+    } catch (const std::runtime_error &err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << parser;
+        std::exit(1);
+    }
+
+    struct arguments res{};
+    res.dest_ip = parser.get("dest_IP");
+    res.dest_port = parser.get<unsigned int>("dest_port");
+    res.packet_freq = parser.get<double>("packet_freq");
+    res.packet_size = parser.get<unsigned int>("packet_size");
+    res.packet_dscp = (uint8_t) (parser.get<uint8_t>("packet_dscp") << 2);
+    res.timeout = parser.get<unsigned int>("--timeout");
+    res.verbose = parser.get<bool>("--verbose");
+    res.interface = parser.get("--interface");
+    res.label_byte = parser.get<uint8_t>("--label");
+    res.csv = parser.get<bool>("--csv");
+    res.raw = parser.get<bool>("--raw");
+    res.src_ip = parser.get("--src-ip");
+    res.src_ip_count = parser.get<unsigned int>("--src-ip-count");
+    res.src_port = parser.get<unsigned int>("--src-port");
+    res.src_port_count = parser.get<unsigned int>("--src-port-count");
+    res.backpressure = parse_backpressure_policy(parser.get("--backpressure"));
+    res.retry_queue_size = parser.get<unsigned int>("--retry-queue-size");
+    res.block_deadline_us = parser.get<unsigned int>("--block-deadline");
+    res.overrun = parse_overrun_policy(parser.get("--overrun"));
+    res.max_burst = parser.get<unsigned int>("--max-burst");
+    res.quiet = parser.get<bool>("--quiet");
+    res.benchmark_sizes = parse_numbers(parser.get("--benchmark"), "packet size");
+    res.trial_length = parser.get<unsigned int>("--trial-length");
+    res.tolerance = parser.get<double>("--tolerance");
+    res.loss_ratio = parser.get<double>("--loss-ratio");
+    res.transport = parse_transport_type(parser.get("--transport"));
+    res.pcap_file = parser.get("--pcap-file");
+    res.perf = parser.get<bool>("--perf");
+    res.shm_name = parser.get("--shm-name");
+    res.shm = parser.get<bool>("--shm") || !res.shm_name.empty();
+    res.control = parser.get("--control");
+    res.aligned = parser.is_used("--start-at") || parser.is_used("--phase-offset");
+    res.start_at_ns = parser.get<long long>("--start-at");
+    res.phase_offset_ns = parser.get<long long>("--phase-offset");
+    res.clock = parse_clock(parser.get("--clock"));
+    res.instances = parser.get<unsigned int>("--instances");
+    res.cpus = parse_numbers(parser.get("--cpus"), "CPU");
+    res.interfaces = split_list(parser.get("--interfaces"));
+    res.rt = parser.get<bool>("--rt");
+    res.warmup_s = parser.get<double>("--warmup");
+    const std::string warmup_mode{parser.get("--warmup-mode")};
+    if (warmup_mode != "probe" && warmup_mode != "silent") {
+        std::cerr << "Unknown warm-up mode " << warmup_mode << ", expected probe or silent." << std::endl;
+        std::exit(1);
+    }
+    res.warmup_probes = warmup_mode == "probe";
+    res.trace = parser.get("--trace");
+    res.trace_events = parser.get<unsigned int>("--trace-events");
+    res.replay = parser.get("--replay");
+    res.replay_speed = parser.get<double>("--replay-speed");
+    res.replay_fixed_rate = parser.get<bool>("--replay-fixed-rate");
+    res.payload_file = parser.get("--payload-file");
+    res.payload_mode = res.payload_file.empty() ? parse_payload_mode(parser.get("--payload")) : PayloadMode::file;
+    res.payload_seed = parser.get<unsigned long long>("--payload-seed");
+    res.payload_pool = parser.get<unsigned int>("--payload-pool");
+    res.crc = parser.get<bool>("--crc");
+    res.tcp_file = parser.get("--tcp-file");
+    res.queue_log = parser.get("--queue-log");
+    res.queue_sample_ms = parser.get<unsigned int>("--sample-queues");
+    if (res.queue_sample_ms == 0 && !res.queue_log.empty()) {
+        res.queue_sample_ms = 100;
+    }
+    // A poll mode transport is only worth it with a poll mode pacer
+    if (res.transport == TransportType::dpdk && !parser.is_used("--spin-us")) {
+        res.spin_ns = INT64_MAX;
+    } else {
+        res.spin_ns = (int64_t) parser.get<unsigned int>("--spin-us") * 1000;
+    }
+#ifdef PACKET_GENERATOR_DPDK
+    res.dpdk_eal_args = parser.get("--dpdk-eal");
+    res.dpdk_port = parser.get<uint16_t>("--dpdk-port");
+    res.dpdk_dest_mac = parser.get("--dpdk-dest-mac");
+#endif
+    res.pacing_rate_mbps = parser.get<double>("--pacing-rate");
+    if (res.shm && res.shm_name.empty()) {
+        res.shm_name = default_live_stats_name(getpid());
+    } else if (res.shm && res.shm_name[0] != '/') {
+        res.shm_name.insert(0, "/");
+    }
+
+    if (!res.benchmark_sizes.empty()) {
+        res.packet_size = *std::min_element(res.benchmark_sizes.begin(), res.benchmark_sizes.end());
+        if (res.trial_length == 0 || res.tolerance <= 0 || res.tolerance >= 1) {
+            std::cerr << "Benchmark trials need a length of at least a second and a tolerance between 0 and 1."
+                      << std::endl;
+            std::exit(1);
+        }
+        // Below 0 every trial fails, and at 1 every trial passes
+        if (!(res.loss_ratio >= 0 && res.loss_ratio < 1)) {
+            std::cerr << "Benchmark loss ratio must be at least 0 and below 1." << std::endl;
+            std::exit(1);
+        }
+    }
+    if (!res.benchmark_sizes.empty() && !res.control.empty()) {
+        std::cerr << "The benchmark sets the rate itself and can't be controlled at runtime." << std::endl;
+        std::exit(1);
+    }
+    if (!res.benchmark_sizes.empty() && res.aligned) {
+        std::cerr << "Benchmark trials can't be aligned to a start time." << std::endl;
+        std::exit(1);
+    }
+    if (!res.benchmark_sizes.empty() && res.warmup_s > 0) {
+        std::cerr << "Benchmark trials can't be preceded by a warm-up." << std::endl;
+        std::exit(1);
+    }
+    if (res.warmup_s < 0) {
+        std::cerr << "Warm-up time must not be negative." << std::endl;
+        std::exit(1);
+    }
+    if (res.instances == 0) {
+        std::cerr << "At least one instance is needed." << std::endl;
+        std::exit(1);
+    }
+    if (res.instances > 1 && (!res.benchmark_sizes.empty() || !res.control.empty() || res.shm)) {
+        std::cerr << "Multiple instances can't be combined with --benchmark, --control or --shm." << std::endl;
+        std::exit(1);
+    }
+    if (!res.replay.empty() && (res.raw || res.transport == TransportType::pcap ||
+                                res.transport == TransportType::tap || res.transport == TransportType::dpdk)) {
+        std::cerr << "Replayed payloads are sent as they are and can't be given generated IP headers." << std::endl;
+        std::exit(1);
+    }
+    // Locking memory would pull the whole mapped capture into memory
+    if (!res.replay.empty() && (!res.benchmark_sizes.empty() || !res.control.empty() || res.instances > 1 || res.rt)) {
+        std::cerr << "Replay can't be combined with --benchmark, --control, --instances or --rt." << std::endl;
+        std::exit(1);
+    }
+    if (!res.replay.empty() && (res.crc || res.payload_mode != PayloadMode::zero)) {
+        std::cerr << "Replayed payloads are sent as captured and can't be given generated content or a CRC."
+                  << std::endl;
+        std::exit(1);
+    }
+    if (res.payload_mode == PayloadMode::file && res.payload_file.empty()) {
+        std::cerr << "Payload mode file needs a --payload-file." << std::endl;
+        std::exit(1);
+    }
+    if (res.transport == TransportType::tcp &&
+        (res.raw || res.crc || !res.replay.empty() || !res.benchmark_sizes.empty() || !res.control.empty() ||
+         res.instances > 1 || res.warmup_s > 0)) {
+        std::cerr << "A TCP stream can't be combined with --raw, --crc, --replay, --benchmark, --control, --instances "
+                     "or --warmup." << std::endl;
+        std::exit(1);
+    }
+    // Every process would initialise DPDK as the primary process of the same port
+    if (res.transport == TransportType::dpdk && res.instances > 1) {
+        std::cerr << "The dpdk transport can't be combined with --instances." << std::endl;
+        std::exit(1);
+    }
+    if (res.transport == TransportType::tap && res.interface.empty() && (res.instances == 1 || res.interfaces.empty())) {
+        std::cerr << "The tap transport needs the TAP device to write to as --interface." << std::endl;
+        std::exit(1);
+    }
+    // Samples are summarised in the report of a single generator run
+    if (res.queue_sample_ms > 0 &&
+        (!res.benchmark_sizes.empty() || res.instances > 1 || res.transport == TransportType::tcp)) {
+        std::cerr << "Queue sampling can't be combined with --benchmark, --instances or --transport tcp."
+                  << std::endl;
+        std::exit(1);
+    }
+    if (res.pacing_rate_mbps < 0) {
+        std::cerr << "Pacing rate must not be negative." << std::endl;
+        std::exit(1);
+    }
+    if (res.replay_speed <= 0) {
+        std::cerr << "Replay speed must be positive." << std::endl;
+        std::exit(1);
+    }
+    if (res.start_at_ns < 0) {
+        std::cerr << "Start time must not lie before the epoch." << std::endl;
+        std::exit(1);
+    }
+    if (res.packet_size < 5) {
+        std::cerr << "Packet size must be at least 5 bytes to hold the label and sequence number." << std::endl;
+        std::exit(1);
+    }
+    // Benchmarks start at the smallest size, but must be able to send the largest
+    const unsigned int max_packet_size{res.benchmark_sizes.empty() ? res.packet_size : *std::max_element(
+            res.benchmark_sizes.begin(), res.benchmark_sizes.end())};
+    if (max_packet_size > MAX_UDP_PAYLOAD_BYTES) {
+        std::cerr << "Packet size must be at most " << MAX_UDP_PAYLOAD_BYTES << " bytes to fit a UDP datagram."
+                  << std::endl;
+        std::exit(1);
+    }
+    if (res.crc && res.packet_size < PAYLOAD_HEADER_BYTES + CRC_TRAILER_BYTES) {
+        std::cerr << "Packet size must be at least 9 bytes to also hold a CRC." << std::endl;
+        std::exit(1);
+    }
+    // Every instance rotates over its own range of source ports
+    if (res.src_ip_count == 0 || res.src_port_count == 0 ||
+        res.src_port + (uint64_t) res.src_port_count * res.instances > 65536) {
+        std::cerr << "Source address and port ranges must be non-empty and fit in the port space." << std::endl;
+        std::exit(1);
+    }
+
+    // Packets are at least a nanosecond apart, and every instance's timer has to hold the interval between its own
+    const double min_packet_freq{(double) S_TO_NS / MAX_INTERVAL_NS * res.instances};
+    if (!(res.packet_freq >= min_packet_freq && res.packet_freq <= S_TO_NS)) {
+        std::cerr << "Packet frequency must be between " << min_packet_freq << " and " << S_TO_NS << "Hz."
+                  << std::endl;
+        std::exit(1);
+    }
+    if (res.backpressure == BackpressurePolicy::queue && res.retry_queue_size == 0) {
+        std::cerr << "Retry queue size must be at least 1." << std::endl;
+        std::exit(1);
+    }
+
+    if (res.verbose) {
+        if (res.transport == TransportType::tcp) {
+            std::cout << "Connecting to " << res.dest_ip << ":" << res.dest_port << " over TCP with DSCP "
+                      << (unsigned int) (res.packet_dscp >> 2) << "." << std::endl;
+        } else {
+            std::cout << "Sending UDP packets to " << res.dest_ip << ":" << res.dest_port << " at "
+                      << res.packet_freq << "Hz." << std::endl;
+            std::cout << "Packet size is " << res.packet_size << "B, DSCP is "
+                      << (unsigned int) (res.packet_dscp >> 2) << ", and label is " << (unsigned int) res.label_byte
+                      << "." << std::endl;
+        }
+        if (res.timeout)
+            std::cout << "Timeout in " << res.timeout << " seconds." << std::endl;
+        else
+            std::cout << "Timeout not specified, running indefinitely." << std::endl;
+        if (!res.interface.empty()) {
+            std::cout << "Binding to interface " << res.interface << "." << std::endl;
+        } else {
+            std::cout << "Not bound to an interface." << std::endl;
+        }
+        if (res.raw) {
+            std::cout << "Using a raw socket, rotating over " << res.src_ip_count << " source address(es) and "
+                      << res.src_port_count << " source port(s) starting at port " << res.src_port << "."
+                      << std::endl;
+        }
+        std::cout << "Sending over the " << parser.get("--transport") << " transport." << std::endl;
+        if (res.queue_sample_ms > 0) {
+            std::cout << "Sampling queues every " << res.queue_sample_ms << "ms"
+                      << (res.interface.empty() ? ", the qdisc and driver only with --interface" : "") << "."
+                      << std::endl;
+        }
+        if (res.aligned) {
+            std::cout << "Aligning departures to " << res.start_at_ns << "ns offset by " << res.phase_offset_ns
+                      << "ns on the " << parser.get("--clock") << " clock." << std::endl;
+        }
+        if (!res.replay.empty() && res.replay_fixed_rate) {
+            std::cout << "Replaying " << res.replay << " at " << res.packet_freq << "Hz." << std::endl;
+        } else if (!res.replay.empty()) {
+            std::cout << "Replaying " << res.replay << " at " << res.replay_speed << " times the captured speed."
+                      << std::endl;
+        }
+        if (res.transport == TransportType::tcp) {
+            std::cout << "Streaming " << (res.tcp_file.empty() ? "generated data" : res.tcp_file) << " over TCP";
+            if (res.pacing_rate_mbps > 0) {
+                std::cout << ", paced to " << res.pacing_rate_mbps << "Mbit/s";
+            }
+            std::cout << "." << std::endl;
+        } else if (res.replay.empty()) {
+            std::cout << "Filling payloads with "
+                      << (res.payload_mode == PayloadMode::file ? "slices of " + res.payload_file : parser.get("--payload"))
+                      << (res.crc ? " and a CRC32C trailer" : "") << ", rotating over "
+                      << std::max<unsigned int>(res.payload_pool, MAX_BATCH) << " buffers." << std::endl;
+        }
+        if (res.instances > 1) {
+            std::cout << "Forking " << res.instances << " instances, each sending at "
+                      << res.packet_freq / res.instances << "Hz." << std::endl;
+        }
+        if (!res.control.empty()) {
+            std::cout << "Accepting commands on " << res.control << "." << std::endl;
+        }
+        std::cout << "Backpressure policy is " << parser.get("--backpressure") << ", overrun policy is "
+                  << parser.get("--overrun") << "." << std::endl;
+    }
+
+    return res;
+}
@@ -0,0 +1,157 @@
+#include "benchmark.h"
+#include "constants.h"
+#include "generator.h"
+#include "receiver.h"
+#include "signal_handling.h"
+#include "tsc_clock.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+
+// Time to wait for packets still in flight after a trial, in milliseconds
+const unsigned int trial_drain_ms{200};
+// Most packets per trial to measure latency for
+const uint32_t max_latency_samples{1 << 20};
+
+/**
+ * Outcome of sending at a single rate for the trial length.
+ */
+struct TrialResult {
+    double rate;
+    uint64_t scheduled;
+    uint64_t received;
+    double loss_ratio;
+    uint64_t latency_samples;
+    double latency_min_us;
+    double latency_avg_us;
+    double latency_max_us;
+};
+
+static auto run_trial(const struct arguments &trial_args, double rate, Receiver &receiver) -> TrialResult {
+    struct arguments args{trial_args};
+    args.packet_freq = rate;
+
+    // Spread the latency samples evenly over the trial
+    const auto expected{(uint64_t) std::ceil(rate * args.timeout)};
+    const auto stride{(uint32_t) std::max<uint64_t>(1, (expected + max_latency_samples - 1) / max_latency_samples)};
+    const auto capacity{(uint32_t) (expected / stride + 2)};
+    std::vector<int64_t> send_times(capacity, -1);
+    std::vector<int64_t> arrival_times(capacity, -1);
+
+    receiver.start(arrival_times.data(), capacity, stride);
+    record_send_times(send_times.data(), capacity, stride);
+    IntervalTimer intervalTimer{interval_for(rate), args.overrun, args.max_burst};
+    intervalTimer.set_spin(args.spin_ns);
+    run_generator(args, intervalTimer);
+    record_send_times(nullptr, 0, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(trial_drain_ms));
+    receiver.stop();
+
+    TrialResult result{};
+    result.rate = rate;
+    // Ticks the sender could not keep up with are lost as well
+    result.scheduled = attempted_packets() + intervalTimer.stats().skipped_ticks.load();
+    result.received = std::min(receiver.count(), result.scheduled);
+    result.loss_ratio = result.scheduled ? 1.0 - (double) result.received / (double) result.scheduled : 1.0;
+
+    double latency_sum_us{0};
+    result.latency_min_us = INFINITY;
+    for (uint32_t i = 0; i < capacity; i++) {
+        if (send_times[i] < 0 || arrival_times[i] < 0) {
+            continue;
+        }
+        const double latency_us{(double) (arrival_times[i] - ticks_to_realtime_ns((uint64_t) send_times[i])) / 1000};
+        result.latency_min_us = std::min(result.latency_min_us, latency_us);
+        result.latency_max_us = std::max(result.latency_max_us, latency_us);
+        latency_sum_us += latency_us;
+        result.latency_samples++;
+    }
+    result.latency_avg_us = result.latency_samples ? latency_sum_us / (double) result.latency_samples : 0;
+    if (!result.latency_samples) {
+        result.latency_min_us = 0;
+    }
+    return result;
+}
+
+static void print_row(const struct arguments &args, unsigned int packet_size, const TrialResult &result) {
+    const double throughput_mbps{result.rate * (packet_size + IP_UDP_HEADER_BYTES) * 8 / S_TO_US};
+    if (args.csv) {
+        std::cout << packet_size << ", " << result.rate << ", " << throughput_mbps << ", " << result.loss_ratio
+                  << ", " << result.latency_min_us << ", " << result.latency_avg_us << ", " << result.latency_max_us
+                  << std::endl;
+        return;
+    }
+    std::cout << std::setw(10) << packet_size << std::setw(16) << result.rate << std::setw(18) << throughput_mbps
+              << std::setw(12) << result.loss_ratio * 100 << std::setw(14) << result.latency_min_us << std::setw(14)
+              << result.latency_avg_us << std::setw(14) << result.latency_max_us << std::endl;
+}
+
+void run_benchmark(const struct arguments &args) {
+    Receiver receiver{args.dest_port, args.label_byte, ""};
+
+    std::vector<std::pair<unsigned int, TrialResult>> results;
+    for (const unsigned int packet_size: args.benchmark_sizes) {
+        struct arguments trial_args{args};
+        trial_args.packet_size = packet_size;
+        trial_args.timeout = args.trial_length;
+        trial_args.quiet = true;
+        open_transport(trial_args);
+
+        // The highest rate is tried first, as it often passes on fast paths. Below a packet per trial, loss can't
+        // be measured any more, so a path that drops everything ends the search there.
+        const double min_rate{1.0 / args.trial_length};
+        double lossless_rate{0};
+        double lossy_rate{args.packet_freq};
+        double rate{args.packet_freq};
+        TrialResult best{};
+        while (!keyboard_interrupt) {
+            const TrialResult trial{run_trial(trial_args, rate, receiver)};
+            const bool passed{trial.loss_ratio <= args.loss_ratio};
+            if (args.verbose) {
+                std::cout << "Trial with " << packet_size << "B packets at " << rate << "Hz: received "
+                          << trial.received << " of " << trial.scheduled << " packets, " << (passed ? "passed"
+                                                                                                     : "failed")
+                          << "." << std::endl;
+            }
+            if (passed) {
+                lossless_rate = rate;
+                best = trial;
+            } else {
+                lossy_rate = rate;
+            }
+            if (lossy_rate - lossless_rate <= args.tolerance * lossy_rate) {
+                break;
+            }
+            rate = (lossless_rate + lossy_rate) / 2;
+            if (rate < min_rate) {
+                break;
+            }
+        }
+        if (lossless_rate > 0) {
+            results.emplace_back(packet_size, best);
+        } else if (!keyboard_interrupt) {
+            std::cout << "No lossless rate found for " << packet_size << "B packets down to " << lossy_rate << "Hz."
+                      << std::endl;
+        }
+        if (keyboard_interrupt) {
+            break;
+        }
+    }
+
+    if (args.csv) {
+        std::cout << "size_B, rate_Hz, throughput_Mbps, loss_ratio, latency_min_us, latency_avg_us, latency_max_us"
+                  << std::endl;
+    } else {
+        std::cout << std::setw(10) << "Size (B)" << std::setw(16) << "Rate (Hz)" << std::setw(18)
+                  << "IP rate (Mbit/s)" << std::setw(12) << "Loss (%)" << std::setw(14) << "Min lat (us)"
+                  << std::setw(14) << "Avg lat (us)" << std::setw(14) << "Max lat (us)" << std::endl;
+    }
+    for (const auto &[packet_size, result]: results) {
+        print_row(args, packet_size, result);
+    }
+}
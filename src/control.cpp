@@ -0,0 +1,181 @@
+#include "constants.h"
+#include "control.h"
+#include "IntervalTimer.h"
+#include "signal_handling.h"
+
+#include <cerrno> //errno
+#include <cstdio> //perror
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Longest command line accepted before a client is disconnected
+const size_t max_line_length{4096};
+
+ControlServer::ControlServer(EventLoop &loop, std::string path, const RuntimeSettings &initial,
+                             const LiveStatsSegment &live_stats) :
+        loop(loop), path(std::move(path)), live_stats(live_stats), pending(initial) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (this->path.length() >= sizeof(addr.sun_path)) {
+        std::cerr << "Control socket path " << this->path << " is too long." << std::endl;
+        exit(1);
+    }
+    std::strncpy(addr.sun_path, this->path.c_str(), sizeof(addr.sun_path) - 1);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        perror("Can't open control socket");
+        exit(errno);
+    }
+    unlink(this->path.c_str());
+    if (bind(listen_fd, (sockaddr *) &addr, sizeof(addr)) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+        perror("Can't listen on control socket");
+        exit(errno);
+    }
+    loop.watch(listen_fd, EPOLLIN, [this](uint32_t) { accept_clients(); });
+}
+
+ControlServer::~ControlServer() {
+    while (!clients.empty()) {
+        disconnect(clients.begin()->first);
+    }
+    loop.unwatch(listen_fd);
+    close(listen_fd);
+    unlink(path.c_str());
+}
+
+auto ControlServer::take_changes() -> RuntimeSettings {
+    const std::lock_guard<std::mutex> lock{mutex};
+    changed.store(false, std::memory_order_relaxed);
+    return pending;
+}
+
+auto ControlServer::wait_resumed() -> bool {
+    std::unique_lock<std::mutex> lock{mutex};
+    resumed.wait(lock, [this] { return !pending.paused || keyboard_interrupt; });
+    return !keyboard_interrupt;
+}
+
+void ControlServer::interrupt() {
+    {
+        const std::lock_guard<std::mutex> lock{mutex};
+    }
+    resumed.notify_all();
+}
+
+void ControlServer::accept_clients() {
+    int client_fd;
+    while ((client_fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        clients[client_fd] = "";
+        loop.watch(client_fd, EPOLLIN | EPOLLRDHUP, [this, client_fd](uint32_t) { serve_client(client_fd); });
+    }
+}
+
+void ControlServer::serve_client(int client_fd) {
+    char buffer[512];
+    ssize_t received;
+    while ((received = recv(client_fd, buffer, sizeof(buffer), 0)) > 0) {
+        std::string &line{clients[client_fd]};
+        line.append(buffer, (size_t) received);
+
+        size_t end;
+        while ((end = line.find('\n')) != std::string::npos) {
+            const std::string reply{execute(line.substr(0, end)) + "\n"};
+            line.erase(0, end + 1);
+            // Replies are short enough to fit the socket buffer of a client that reads them
+            if (send(client_fd, reply.data(), reply.length(), MSG_NOSIGNAL) < 0) {
+                disconnect(client_fd);
+                return;
+            }
+        }
+        if (line.length() > max_line_length) {
+            disconnect(client_fd);
+            return;
+        }
+    }
+    if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        disconnect(client_fd);
+    }
+}
+
+void ControlServer::disconnect(int client_fd) {
+    loop.unwatch(client_fd);
+    close(client_fd);
+    clients.erase(client_fd);
+}
+
+auto ControlServer::execute(const std::string &line) -> std::string {
+    std::istringstream words{line};
+    std::string command;
+    words >> command;
+    std::ostringstream reply;
+    reply << std::fixed;
+
+    if (command == "set") {
+        const std::lock_guard<std::mutex> lock{mutex};
+        RuntimeSettings settings{pending};
+        std::string setting;
+        while (words >> setting) {
+            const size_t separator{setting.find('=')};
+            const std::string key{setting.substr(0, separator)};
+            double value;
+            try {
+                if (separator == std::string::npos) {
+                    throw std::invalid_argument(setting);
+                }
+                value = std::stod(setting.substr(separator + 1));
+            } catch (const std::logic_error &) {
+                return "error: expected key=value, got " + setting;
+            }
+            // Rates are bounded like packet_freq, so that the timer's interval stays between 1ns and MAX_INTERVAL_NS
+            if (key == "rate" && value >= (double) S_TO_NS / MAX_INTERVAL_NS && value <= S_TO_NS) {
+                settings.packet_freq = value;
+            } else if (key == "size" && value >= 5 && value <= MAX_UDP_PAYLOAD_BYTES) {
+                settings.packet_size = (unsigned int) value;
+            } else if (key == "dscp" && value >= 0 && value < 64) {
+                settings.packet_dscp = (uint8_t) ((unsigned int) value << 2);
+            } else {
+                return "error: invalid setting " + setting;
+            }
+        }
+        pending = settings;
+        changed.store(true, std::memory_order_release);
+        return "ok";
+    }
+    if (command == "pause" || command == "resume") {
+        {
+            const std::lock_guard<std::mutex> lock{mutex};
+            pending.paused = command == "pause";
+            changed.store(true, std::memory_order_release);
+        }
+        resumed.notify_all();
+        return "ok";
+    }
+    if (command == "get") {
+        const std::lock_guard<std::mutex> lock{mutex};
+        reply << "rate=" << pending.packet_freq << " size=" << pending.packet_size << " dscp="
+              << (unsigned int) (pending.packet_dscp >> 2) << " paused=" << pending.paused;
+        return reply.str();
+    }
+    if (command == "stats") {
+        const LiveStatsSnapshot snapshot{read_live_stats(live_stats)};
+        uint64_t errors{0};
+        for (const uint64_t error_count: snapshot.errors) {
+            errors += error_count;
+        }
+        reply << "attempted=" << snapshot.attempted << " successful=" << snapshot.successful << " dropped="
+              << snapshot.dropped << " queued=" << snapshot.queued << " errors=" << errors << " rate="
+              << snapshot.current_rate << " target_rate=" << snapshot.target_rate << " missed="
+              << snapshot.missed_deadlines << " skipped=" << snapshot.skipped_ticks << " lateness_p50_ns="
+              << snapshot.lateness_p50_ns << " lateness_p99_ns=" << snapshot.lateness_p99_ns << " lateness_max_ns="
+              << snapshot.lateness_max_ns;
+        return reply.str();
+    }
+    return "error: unknown command " + command + ", expected set, pause, resume, get or stats";
+}
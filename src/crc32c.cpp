@@ -0,0 +1,71 @@
+#include "crc32c.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+// Reflected Castagnoli polynomial
+const uint32_t crc32c_polynomial{0x82f63b78};
+
+static auto make_table() -> std::array<uint32_t, 256> {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t byte = 0; byte < 256; byte++) {
+        uint32_t crc{byte};
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? crc >> 1 ^ crc32c_polynomial : crc >> 1;
+        }
+        table[byte] = crc;
+    }
+    return table;
+}
+
+static auto crc32c_software(uint32_t state, const void *data, size_t length) -> uint32_t {
+    static const std::array<uint32_t, 256> table{make_table()};
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < length; i++) {
+        state = table[(state ^ bytes[i]) & 0xff] ^ state >> 8;
+    }
+    return state;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static auto crc32c_hardware(uint32_t state, const void *data, size_t length) -> uint32_t {
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    uint64_t crc{state};
+    size_t i{0};
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        crc = _mm_crc32_u64(crc, word);
+    }
+    auto crc32{(uint32_t) crc};
+    for (; i < length; i++) {
+        crc32 = _mm_crc32_u8(crc32, bytes[i]);
+    }
+    return crc32;
+}
+#endif
+
+using Crc32cFunction = auto (*)(uint32_t, const void *, size_t) -> uint32_t;
+
+static auto select_crc32c() -> Crc32cFunction {
+#if defined(__x86_64__)
+    // May run before the constructor that initialises the CPU model
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        return crc32c_hardware;
+    }
+#endif
+    return crc32c_software;
+}
+
+// Chosen once, before main, so that the per-packet call is a plain indirect call
+static const Crc32cFunction crc32c_implementation{select_crc32c()};
+
+auto crc32c_extend(uint32_t state, const void *data, size_t length) -> uint32_t {
+    return crc32c_implementation(state, data, length);
+}
@@ -0,0 +1,186 @@
+#include "arguments.h"
+#include "dpdk_transport.h"
+
+#include <algorithm>
+#include <cerrno> //errno
+#include <cstdio> //perror
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <rte_eal.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_ether.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+// Shared by every transport this process opens, mbufs still on a stopped port's ring are only returned to it later
+const char mbuf_pool_name[]{"packet_generator_tx"};
+// A mempool is most efficient with one less than a power of two elements
+const unsigned int mbuf_count{8191};
+const unsigned int mbuf_cache_size{256};
+const uint16_t tx_descriptors{1024};
+// Attempts to hand a batch to a full transmit ring before dropping what is left of it
+const unsigned int tx_burst_attempts{64};
+
+static bool eal_initialised{false};
+
+/**
+ * Exit with the error a DPDK call returned as a negative errno.
+ */
+[[noreturn]] static void dpdk_error(const char *message, int error) {
+    errno = -error;
+    perror(message);
+    exit(errno);
+}
+
+/**
+ * Initialise the environment abstraction layer once per process.
+ * @param eal_args Space separated EAL arguments.
+ */
+static void init_eal(const std::string &eal_args) {
+    // The EAL keeps pointers into its arguments
+    static std::vector<std::string> words{"packet_generator"};
+    std::istringstream stream{eal_args};
+    std::string word;
+    while (stream >> word) {
+        words.push_back(word);
+    }
+    std::vector<char *> argv;
+    for (auto &each: words) {
+        argv.push_back(each.data());
+    }
+
+    // The EAL pins the calling thread to its main lcore, but the sending thread already is where it should be
+    cpu_set_t cpus;
+    pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (rte_eal_init((int) argv.size(), argv.data()) < 0) {
+        std::cerr << "Can't initialise DPDK: " << rte_strerror(rte_errno) << std::endl;
+        exit(1);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    eal_initialised = true;
+}
+
+DpdkTransport::DpdkTransport(const struct arguments &args) : port(args.dpdk_port) {
+    if (!eal_initialised) {
+        init_eal(args.dpdk_eal_args);
+    }
+    if (!rte_eth_dev_is_valid_port(port)) {
+        std::cerr << "DPDK port " << port << " does not exist, " << rte_eth_dev_count_avail()
+                  << " port(s) are available." << std::endl;
+        exit(1);
+    }
+
+    rte_ether_hdr header{};
+    if (rte_ether_unformat_addr(args.dpdk_dest_mac.c_str(), &header.dst_addr) < 0) {
+        std::cerr << "Invalid destination MAC address " << args.dpdk_dest_mac << "." << std::endl;
+        exit(1);
+    }
+    int error{rte_eth_macaddr_get(port, &header.src_addr)};
+    if (error < 0) {
+        dpdk_error("Can't read DPDK port address", error);
+    }
+    header.ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+
+    const int socket{rte_eth_dev_socket_id(port)};
+    mbuf_pool = rte_mempool_lookup(mbuf_pool_name);
+    if (mbuf_pool == nullptr) {
+        mbuf_pool = rte_pktmbuf_pool_create(mbuf_pool_name, mbuf_count, mbuf_cache_size, 0,
+                                            RTE_MBUF_DEFAULT_BUF_SIZE, socket);
+        if (mbuf_pool == nullptr) {
+            dpdk_error("Can't create DPDK mbuf pool", -rte_errno);
+        }
+    }
+    max_frame_bytes = rte_pktmbuf_data_room_size(mbuf_pool) - RTE_PKTMBUF_HEADROOM;
+
+    // Transmit only, a generator has nothing to receive
+    const rte_eth_conf port_conf{};
+    error = rte_eth_dev_configure(port, 0, 1, &port_conf);
+    if (error < 0) {
+        dpdk_error("Can't configure DPDK port", error);
+    }
+    uint16_t descriptors{tx_descriptors};
+    error = rte_eth_dev_adjust_nb_rx_tx_desc(port, nullptr, &descriptors);
+    if (error < 0) {
+        dpdk_error("Can't size DPDK transmit ring", error);
+    }
+    error = rte_eth_tx_queue_setup(port, 0, descriptors, socket, nullptr);
+    if (error < 0) {
+        dpdk_error("Can't set up DPDK transmit queue", error);
+    }
+
+    // Allocation hands out mbufs with their data as it was left, so the header only has to be written once. Setting
+    // up the queue above returned any mbufs a previous transport left on the ring. Taken in chunks no larger than
+    // the cache, as larger requests bypass whatever the cache holds.
+    std::vector<rte_mbuf *> mbufs(mbuf_count);
+    unsigned int prefilled{0};
+    while (prefilled < mbuf_count) {
+        const unsigned int chunk{std::min(mbuf_cache_size, mbuf_count - prefilled)};
+        if (rte_pktmbuf_alloc_bulk(mbuf_pool, mbufs.data() + prefilled, chunk) != 0) {
+            break;
+        }
+        prefilled += chunk;
+    }
+    if (prefilled == 0) {
+        dpdk_error("Can't prefill DPDK mbufs", -ENOBUFS);
+    }
+    for (unsigned int i = 0; i < prefilled; i++) {
+        memcpy(rte_pktmbuf_mtod(mbufs[i], void *), &header, sizeof(header));
+    }
+    rte_pktmbuf_free_bulk(mbufs.data(), prefilled);
+
+    error = rte_eth_dev_start(port);
+    if (error < 0) {
+        dpdk_error("Can't start DPDK port", error);
+    }
+}
+
+DpdkTransport::~DpdkTransport() {
+    const int error{rte_eth_dev_stop(port)};
+    if (error < 0) {
+        std::cerr << "Can't stop DPDK port: " << rte_strerror(-error) << std::endl;
+    }
+}
+
+void DpdkTransport::send_batch(const OutgoingPacket *packets, size_t count) {
+    rte_mbuf *mbufs[MAX_BATCH];
+    if (rte_pktmbuf_alloc_bulk(mbuf_pool, mbufs, (unsigned int) count) != 0) {
+        send_stats.errors[ENOBUFS] += count;
+        send_stats.dropped += count;
+        return;
+    }
+
+    uint16_t ready{0};
+    for (size_t i = 0; i < count; i++) {
+        rte_mbuf *mbuf{mbufs[i]};
+        const size_t frame_bytes{sizeof(rte_ether_hdr) + packets[i].length};
+        if (frame_bytes > max_frame_bytes) {
+            rte_pktmbuf_free(mbuf);
+            send_stats.errors[EMSGSIZE]++;
+            send_stats.dropped++;
+            continue;
+        }
+        memcpy(rte_pktmbuf_mtod_offset(mbuf, void *, sizeof(rte_ether_hdr)), packets[i].data, packets[i].length);
+        mbuf->data_len = (uint16_t) frame_bytes;
+        mbuf->pkt_len = (uint32_t) frame_bytes;
+        mbufs[ready++] = mbuf;
+    }
+
+    uint16_t sent{0};
+    for (unsigned int attempt = 0; attempt < tx_burst_attempts && sent < ready; attempt++) {
+        sent += rte_eth_tx_burst(port, 0, mbufs + sent, ready - sent);
+    }
+    send_stats.successful += sent;
+    if (sent < ready) {
+        rte_pktmbuf_free_bulk(mbufs + sent, ready - sent);
+        send_stats.errors[EAGAIN] += ready - sent;
+        send_stats.dropped += ready - sent;
+    }
+}
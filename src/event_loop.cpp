@@ -0,0 +1,102 @@
+#include "event_loop.h"
+#include "trace.h"
+
+#include <cerrno> //errno
+#include <cstdio> //perror
+#include <cstdlib>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// Most events to take from epoll per system call
+const int event_batch{16};
+
+EventLoop::EventLoop() {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd < 0 || stop_fd < 0) {
+        perror("Can't create event loop");
+        exit(errno);
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = stop_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &event) < 0) {
+        perror("Can't watch event loop stop notification");
+        exit(errno);
+    }
+}
+
+EventLoop::~EventLoop() {
+    stop();
+    close(stop_fd);
+    close(epoll_fd);
+}
+
+void EventLoop::watch(int fd, uint32_t events, std::function<void(uint32_t)> handler) {
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        perror("Can't watch file descriptor");
+        exit(errno);
+    }
+    handlers[fd] = std::move(handler);
+}
+
+void EventLoop::unwatch(int fd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    handlers.erase(fd);
+}
+
+void EventLoop::start() {
+    stop();
+    thread = std::thread(&EventLoop::run, this);
+}
+
+void EventLoop::stop() {
+    if (!thread.joinable()) {
+        return;
+    }
+    // A handler that exits tears the loop down from its own thread, which can't wait for itself
+    if (thread.get_id() == std::this_thread::get_id()) {
+        thread.detach();
+        return;
+    }
+    const uint64_t one{1};
+    if (write(stop_fd, &one, sizeof(one)) < 0) {
+        perror("Can't stop event loop");
+        exit(errno);
+    }
+    thread.join();
+    uint64_t discard;
+    while (read(stop_fd, &discard, sizeof(discard)) > 0) {}
+}
+
+void EventLoop::run() {
+    trace_thread("event loop");
+    epoll_event events[event_batch];
+    while (true) {
+        const int count{epoll_wait(epoll_fd, events, event_batch, -1)};
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Failed to wait for events");
+            exit(errno);
+        }
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.fd == stop_fd) {
+                return;
+            }
+            // A handler may unwatch its own descriptor, so call a copy
+            const auto handler{handlers.find(events[i].data.fd)};
+            if (handler != handlers.end()) {
+                const std::function<void(uint32_t)> callback{handler->second};
+                const int64_t dispatch_start_ns{tracing() ? trace_now() : 0};
+                callback(events[i].events);
+                trace_complete("dispatch", dispatch_start_ns, "fd", (uint64_t) events[i].data.fd);
+            }
+        }
+    }
+}
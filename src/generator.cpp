@@ -0,0 +1,954 @@
+#include "constants.h"
+#include "control.h"
+#include "event_loop.h"
+#include "generator.h"
+#include "live_stats.h"
+#include "memory.h"
+#include "numa.h"
+#include "packet_log.h"
+#include "payload.h"
+#include "pcap_reader.h"
+#include "perf_counters.h"
+#include "queue_sampler.h"
+#include "raw_packet.h"
+#include "signal_handling.h"
+#include "tcp_stream.h"
+#include "trace.h"
+#include "transport.h"
+#include "tsc_clock.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+uint32_t packet_num{0};
+sockaddr_in out_addr{};
+// Arguments the packets are currently built from, which the control socket may change
+struct arguments packet_args{};
+std::unique_ptr<RawPacketTemplate> raw_packet;
+std::unique_ptr<Transport> transport;
+std::unique_ptr<TcpStream> tcp_stream;
+// Pool of prefilled packets that sends rotate over, at least a batch long
+uint8_t *packet_slots{nullptr};
+size_t slot_size{0};
+uint32_t slot_count{0};
+uint32_t next_slot{0};
+// Slot size and count the packet slots were allocated with
+size_t packet_slots_size{0};
+uint32_t packet_slots_count{0};
+// Offset of the UDP payload in a slot, past any IP and UDP headers
+size_t payload_offset{0};
+bool stamp_crcs{false};
+// Per slot: CRC32C state over the body, and the checksum sum over the body for raw packets
+std::vector<uint32_t> slot_body_crcs;
+std::vector<uint64_t> slot_body_sums;
+std::unique_ptr<PayloadSource> payload_source;
+OutgoingPacket batch[MAX_BATCH];
+std::unique_ptr<PerfCounters> perf_counters;
+std::vector<PerfPhase> perf_phases;
+// Declared before the objects that watch descriptors on it, which unwatch them when destroyed in reverse order.
+// stop_event_loop() also runs at exit, so that the loop stops before any object its handlers use goes away.
+std::unique_ptr<EventLoop> event_loop;
+std::unique_ptr<LiveStatsPublisher> live_stats;
+std::unique_ptr<ControlServer> control;
+std::unique_ptr<QueueSampler> queue_sampler;
+std::string queue_log;
+
+int64_t *send_times_ticks{nullptr};
+uint32_t send_times_capacity{0};
+uint32_t send_times_stride{1};
+
+// Time to wait for queued packets to leave after the last tick, in microseconds
+const long flush_timeout_us{100000};
+// Shortest window over which warm-up lateness is compared, in nanoseconds and in ticks
+const int64_t warmup_window_ns{100000000};
+const uint64_t warmup_window_ticks{100};
+// Consecutive windows whose lateness has to agree for it to count as settled
+const unsigned int warmup_settled_windows{3};
+
+/**
+ * Take the next slot of the pool and stamp it with a sequence number, its CRC and its checksums.
+ * @tparam crc Whether to stamp the CRC trailer, as stamp_crcs says.
+ * @tparam raw Whether to prepare the headers of raw_packet.
+ * @return Slot, ready to send.
+ */
+template<bool crc, bool raw>
+auto inline stamp_next_slot(uint32_t my_packet_num) -> uint8_t * {
+    const uint32_t index{next_slot};
+    next_slot = next_slot + 1 == slot_count ? 0 : next_slot + 1;
+    uint8_t *slot{packet_slots + index * slot_size};
+    uint8_t *payload{slot + payload_offset};
+    stamp_packet_num(payload, my_packet_num);
+    if constexpr (crc) {
+        stamp_crc(payload, slot_size - payload_offset, slot_body_crcs[index]);
+    }
+    if constexpr (raw) {
+        raw_packet->prepare(my_packet_num, slot, slot_body_sums[index]);
+    }
+    return slot;
+}
+
+/**
+ * Stamp the next slots of the pool into the batch.
+ * @tparam crc Whether to stamp the CRC trailer.
+ * @tparam raw Whether to prepare the headers of raw_packet.
+ */
+template<bool crc, bool raw>
+void inline stamp_batch(uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        packet_num++;
+        batch[i].data = stamp_next_slot<crc, raw>(packet_num);
+    }
+}
+
+/**
+ * How the send loop stamps packets, fixed for loops whose packets can't be rebuilt with other features while they run.
+ */
+enum class Stamping {
+    /**
+     * Look up stamp_crcs and raw_packet for every batch, as control changes may rebuild the packets.
+     */
+    as_built,
+    /**
+     * Only the sequence number.
+     */
+    plain,
+    /**
+     * Sequence number and CRC trailer.
+     */
+    crc,
+    /**
+     * Sequence number and raw headers.
+     */
+    raw,
+    /**
+     * Sequence number, CRC trailer and raw headers.
+     */
+    raw_crc,
+};
+
+template<Stamping stamping>
+void inline stamp_batch(uint32_t count) {
+    if constexpr (stamping == Stamping::as_built) {
+        if (raw_packet) {
+            stamp_crcs ? stamp_batch<true, true>(count) : stamp_batch<false, true>(count);
+        } else {
+            stamp_crcs ? stamp_batch<true, false>(count) : stamp_batch<false, false>(count);
+        }
+    } else {
+        stamp_batch<stamping == Stamping::crc || stamping == Stamping::raw_crc,
+                stamping == Stamping::raw || stamping == Stamping::raw_crc>(count);
+    }
+}
+
+/**
+ * What the send loop writes out for every packet.
+ */
+enum class PacketOutput {
+    /**
+     * Nothing, with --quiet.
+     */
+    none,
+    /**
+     * A human-readable log line.
+     */
+    text,
+    /**
+     * A csv log line.
+     */
+    csv,
+    /**
+     * No line, but the send time of every stride-th packet, for the benchmark's latency samples.
+     */
+    send_times,
+};
+
+/**
+ * Stamp and send a batch of packets.
+ * @tparam output What to write out per packet.
+ * @tparam instrumented Whether to record trace events.
+ * @tparam stamping What to stamp into every packet.
+ * @tparam TransportType Type of the transport, final so that sending is not a virtual call.
+ */
+template<PacketOutput output, bool instrumented, Stamping stamping, typename TransportType>
+inline void send_packets(TransportType &sender, uint32_t count) {
+    // Take a slot per packet and stamp it with its packet_num
+    const int64_t stamp_start_ns{instrumented && tracing() ? trace_now() : 0};
+    const uint32_t first_packet_num{packet_num + 1};
+    stamp_batch<stamping>(count);
+    if constexpr (instrumented) {
+        trace_complete("stamp", stamp_start_ns, "packets", count);
+    }
+
+    if constexpr (output == PacketOutput::none) {
+        if constexpr (instrumented) {
+            const int64_t send_start_ns{tracing() ? trace_now() : 0};
+            sender.send_batch(batch, count);
+            trace_complete("send", send_start_ns, "packets", count);
+        } else {
+            sender.send_batch(batch, count);
+        }
+        return;
+    }
+
+    const int64_t send_start_ns{instrumented && tracing() ? trace_now() : 0};
+    const uint64_t pre_send_ticks{clock_ticks()};
+    sender.send_batch(batch, count);
+    const uint64_t post_send_ticks{clock_ticks()};
+    if constexpr (instrumented) {
+        trace_complete("send", send_start_ns, "packets", count);
+    }
+
+    if constexpr (output == PacketOutput::send_times) {
+        for (uint32_t my_packet_num = first_packet_num; my_packet_num != packet_num + 1; my_packet_num++) {
+            if (my_packet_num % send_times_stride == 0 && my_packet_num / send_times_stride < send_times_capacity) {
+                send_times_ticks[my_packet_num / send_times_stride] = (int64_t) pre_send_ticks;
+            }
+        }
+    } else {
+        // Report start and end times for transmit call
+        const int64_t log_start_ns{instrumented && tracing() ? trace_now() : 0};
+        for (uint32_t my_packet_num = first_packet_num; my_packet_num != packet_num + 1; my_packet_num++) {
+            log_packet(std::cout, output == PacketOutput::csv, my_packet_num, pre_send_ticks, post_send_ticks);
+        }
+        if constexpr (instrumented) {
+            trace_complete("log", log_start_ns, "packets", count);
+        }
+    }
+}
+
+// Ticks between updates of the live statistics segment, about a millisecond apart
+uint32_t live_stats_period{1};
+uint32_t live_stats_countdown{1};
+
+void build_packets(const struct arguments &args);
+
+/**
+ * Apply settings changed over the control socket. Called at a deadline, so that changes take effect together.
+ * @return Whether the packets due at this deadline should still be sent.
+ */
+auto apply_control_changes(IntervalTimer &intervalTimer) -> bool {
+    RuntimeSettings settings{control->take_changes()};
+    bool send_due{true};
+    if (settings.paused) {
+        if (!control->wait_resumed()) {
+            return false;
+        }
+        // Start a new grid instead of catching up on the time spent paused
+        settings = control->take_changes();
+        intervalTimer.start();
+        send_due = false;
+    }
+
+    const int64_t interval_ns{interval_for(settings.packet_freq)};
+    if (interval_ns != intervalTimer.interval()) {
+        intervalTimer.set_interval(interval_ns);
+        if (live_stats) {
+            live_stats_period = (uint32_t) std::max(1.0, std::round(settings.packet_freq / 1000));
+            live_stats->set_target_rate(settings.packet_freq);
+        }
+    }
+    if (settings.packet_dscp != packet_args.packet_dscp) {
+        transport->set_tos(settings.packet_dscp);
+    }
+    if (settings.packet_size != packet_args.packet_size || settings.packet_dscp != packet_args.packet_dscp) {
+        packet_args.packet_size = settings.packet_size;
+        packet_args.packet_dscp = settings.packet_dscp;
+        build_packets(packet_args);
+    }
+    return send_due;
+}
+
+void inline publish_counters(const IntervalTimer &intervalTimer) {
+    if (live_stats && --live_stats_countdown == 0) {
+        live_stats_countdown = live_stats_period;
+        const int64_t publish_start_ns{tracing() ? trace_now() : 0};
+        live_stats->publish(packet_num, transport->stats(), intervalTimer.stats());
+        trace_complete("publish", publish_start_ns);
+    }
+    if (queue_sampler) {
+        queue_sampler->note_sends(packet_num, transport->stats().successful);
+    }
+}
+
+/**
+ * Start of a run. Timeouts, limits and durations run from the first deadline rather than from the call, so that
+ * waiting for --start-at does not count.
+ */
+struct RunStart {
+    uint64_t ticks{clock_ticks()};
+    bool reached{false};
+
+    /**
+     * Note that a deadline passed, restarting the run from it if it was the first.
+     */
+    void deadline_passed() {
+        if (!reached) {
+            ticks = clock_ticks();
+            reached = true;
+        }
+    }
+};
+
+/**
+ * Send packets on the timer until the timeout passes or the user interrupts.
+ * Every combination of options gets its own instantiation, so that the loop only branches on what it needs.
+ * @tparam output What to write out per packet.
+ * @tparam timed Whether to stop at the timeout.
+ * @tparam instrumented Whether to record trace events, publish counters and take control changes.
+ * @tparam stamping What to stamp into every packet.
+ * @tparam spinning Whether the timer spins at the end of every wait.
+ * @tparam TransportType Type of the transport.
+ * @param timeout_ticks Time to send for, in clock ticks.
+ * @return Time spent sending, in clock ticks.
+ */
+template<PacketOutput output, bool timed, bool instrumented, Stamping stamping, bool spinning, typename TransportType>
+auto send_loop(IntervalTimer &intervalTimer, uint64_t timeout_ticks) -> uint64_t {
+    auto &sender{static_cast<TransportType &>(*transport)};
+    RunStart start{};
+    uint32_t due{intervalTimer.await<instrumented, spinning>()};
+    start.deadline_passed();
+    const uint64_t start_ticks{start.ticks};
+    uint64_t now_ticks{start_ticks};
+    while (true) {
+        if constexpr (instrumented) {
+            if (due > 0 && control && control->has_changes() && !apply_control_changes(intervalTimer)) {
+                due = 0;
+            }
+        }
+        while (due > 0) {
+            const uint32_t count{std::min<uint32_t>(due, MAX_BATCH)};
+            send_packets<output, instrumented, stamping>(sender, count);
+            due -= count;
+        }
+        if constexpr (instrumented) {
+            publish_counters(intervalTimer);
+        }
+        now_ticks = clock_ticks();
+        maybe_reanchor_clock(now_ticks);
+        if (keyboard_interrupt || (timed && now_ticks - start_ticks >= timeout_ticks)) {
+            return now_ticks - start_ticks;
+        }
+        // Wait for the next deadline, which may release several packets when catching up
+        due = intervalTimer.await<instrumented, spinning>();
+    }
+}
+
+using SendLoop = auto (*)(IntervalTimer &, uint64_t) -> uint64_t;
+
+/**
+ * Pick the send loop for the transport in use, falling back to virtual calls for transports without their own.
+ */
+template<PacketOutput output, bool timed, bool instrumented, Stamping stamping, bool spinning>
+auto select_send_loop() -> SendLoop {
+    if (dynamic_cast<SocketTransport *>(transport.get())) {
+        return send_loop<output, timed, instrumented, stamping, spinning, SocketTransport>;
+    }
+    if (dynamic_cast<NullTransport *>(transport.get())) {
+        return send_loop<output, timed, instrumented, stamping, spinning, NullTransport>;
+    }
+    return send_loop<output, timed, instrumented, stamping, spinning, Transport>;
+}
+
+template<PacketOutput output, bool timed, bool instrumented, Stamping stamping>
+auto select_send_loop(bool spinning) -> SendLoop {
+    return spinning ? select_send_loop<output, timed, instrumented, stamping, true>()
+                    : select_send_loop<output, timed, instrumented, stamping, false>();
+}
+
+template<PacketOutput output, bool timed, bool instrumented>
+auto select_send_loop(bool spinning) -> SendLoop {
+    if constexpr (instrumented) {
+        // Control changes may rebuild the packets with or without CRCs while the loop runs
+        return select_send_loop<output, timed, true, Stamping::as_built>(spinning);
+    } else {
+        if (raw_packet) {
+            return stamp_crcs ? select_send_loop<output, timed, false, Stamping::raw_crc>(spinning)
+                              : select_send_loop<output, timed, false, Stamping::raw>(spinning);
+        }
+        return stamp_crcs ? select_send_loop<output, timed, false, Stamping::crc>(spinning)
+                          : select_send_loop<output, timed, false, Stamping::plain>(spinning);
+    }
+}
+
+template<PacketOutput output>
+auto select_send_loop(bool timed, bool instrumented, bool spinning) -> SendLoop {
+    if (timed) {
+        return instrumented ? select_send_loop<output, true, true>(spinning)
+                            : select_send_loop<output, true, false>(spinning);
+    }
+    return instrumented ? select_send_loop<output, false, true>(spinning)
+                        : select_send_loop<output, false, false>(spinning);
+}
+
+/**
+ * Pick the send loop instantiation for the arguments, transport, packets, timer and features in use.
+ */
+auto select_send_loop(const struct arguments &args, const IntervalTimer &intervalTimer) -> SendLoop {
+    const bool timed{args.timeout > 0};
+    const bool instrumented{tracing() || live_stats || control || queue_sampler};
+    const bool spinning{intervalTimer.spinning()};
+    if (send_times_ticks != nullptr) {
+        return select_send_loop<PacketOutput::send_times>(timed, instrumented, spinning);
+    }
+    if (args.quiet) {
+        return select_send_loop<PacketOutput::none>(timed, instrumented, spinning);
+    }
+    if (args.csv) {
+        return select_send_loop<PacketOutput::csv>(timed, instrumented, spinning);
+    }
+    return select_send_loop<PacketOutput::text>(timed, instrumented, spinning);
+}
+
+
+/**
+ * Print the goodput and the kernel's view of a TCP stream.
+ */
+void report_tcp_stats(std::chrono::duration<double, std::micro> duration) {
+    const TcpStreamStats stats{tcp_stream->stats()};
+    const uint64_t acknowledged{stats.bytes_sent - stats.bytes_unacked};
+    std::cout << "Ran for " << duration.count() / S_TO_US << " seconds." << std::endl << "Sent " << stats.bytes_sent
+              << " bytes, of which " << acknowledged << " were acknowledged." << std::endl << "Goodput: "
+              << (double) acknowledged * 8 / duration.count() << "Mbit/s." << std::endl << "Retransmitted "
+              << stats.total_retransmits << " segments. RTT " << (double) stats.rtt_us / 1000 << "ms, variation "
+              << (double) stats.rtt_var_us / 1000 << "ms. Congestion window " << stats.congestion_window
+              << " segments of " << stats.mss << "B." << std::endl;
+}
+
+void report_stats(std::chrono::duration<double, std::micro> duration, const PacerStats &pacer_stats) {
+    if (tcp_stream) {
+        report_tcp_stats(duration);
+        return;
+    }
+    const SendStats &stats{transport->stats()};
+    const uint64_t successful_packet_num{stats.successful};
+    // Ticks that were skipped count as failed attempts
+    const uint64_t skipped_ticks{pacer_stats.skipped_ticks.load()};
+    double successful_percent = successful_packet_num * 100.0 / (packet_num + skipped_ticks);
+    std::cout << "Ran for " << duration.count() / S_TO_US << " seconds." << std::endl << "Attempted to send "
+              << packet_num << " packets, of which " << successful_packet_num << " (" << successful_percent
+              << "%) were successful." << std::endl << "Attempt frequency: "
+              << packet_num / (duration.count() / S_TO_US) << "Hz." << std::endl << "Successful attempt frequency: "
+              << successful_packet_num / (duration.count() / S_TO_US) << "Hz." << std::endl;
+    if (stats.dropped || stats.queued) {
+        std::cout << "Dropped " << stats.dropped << " packets, queued " << stats.queued << " for retrying."
+                  << std::endl;
+    }
+    for (int error = 0; error <= MAX_COUNTED_ERRNO; error++) {
+        if (stats.errors[error]) {
+            std::cout << "Failed send calls with errno " << error << " (" << strerror(error) << "): "
+                      << stats.errors[error] << "." << std::endl;
+        }
+    }
+    if (pacer_stats.missed_deadlines.load()) {
+        std::cout << "Missed " << pacer_stats.missed_deadlines.load() << " deadlines, skipped " << skipped_ticks
+                  << " ticks and sent " << pacer_stats.burst_packets.load() << " packets in catch-up bursts."
+                  << std::endl;
+    }
+    const LatenessHistogram &lateness{pacer_stats.lateness};
+    std::cout << "Wakeup lateness: median " << (double) lateness.percentile(0.5) / 1000 << "us, 99th percentile "
+              << (double) lateness.percentile(0.99) / 1000 << "us, max " << (double) lateness.maximum() / 1000
+              << "us." << std::endl;
+    if (perf_counters) {
+        report_perf_phases(*perf_counters, perf_phases, packet_num);
+    }
+    if (queue_sampler) {
+        queue_sampler->summarise(std::cout);
+        if (!queue_log.empty()) {
+            queue_sampler->write_log(queue_log);
+        }
+    }
+    if (successful_percent < 95) {
+        std::cerr << "Less than 95% successful, aborting..." << std::endl;
+        exit(-95);
+    }
+}
+
+void open_transport(const struct arguments &args) {
+    close_transport();
+
+    // The loopback sink is the socket transport with its destination moved to this host
+    struct arguments effective_args{args};
+    if (args.transport == TransportType::loopback) {
+        effective_args.dest_ip = "127.0.0.1";
+        effective_args.interface = "lo";
+    }
+
+    out_addr.sin_family = AF_INET;
+    out_addr.sin_addr.s_addr = inet_addr(effective_args.dest_ip.c_str());
+    out_addr.sin_port = htons(effective_args.dest_port);
+
+    // Leave room for any payload size the control socket may switch to, or a capture may hold
+    const size_t max_payload_size{args.control.empty() && args.replay.empty() ? args.packet_size
+                                                                              : (unsigned int) MAX_UDP_PAYLOAD_BYTES};
+    transport = make_transport(effective_args, out_addr, max_payload_size + IP_UDP_HEADER_BYTES);
+
+    // TAP devices and DPDK ports bypass the kernel's routes, so only the default route says anything about the source
+    if (transport->needs_ip_headers() && effective_args.src_ip.empty()) {
+        const bool bypasses_kernel{args.transport == TransportType::tap || args.transport == TransportType::dpdk};
+        const std::string route_interface{bypasses_kernel ? "" : effective_args.interface};
+        effective_args.src_ip = inet_ntoa(
+                in_addr{resolve_source_address(out_addr.sin_addr.s_addr, route_interface)});
+    }
+    packet_args = effective_args;
+    if (args.payload_mode != PayloadMode::zero) {
+        payload_source = std::make_unique<PayloadSource>(args.payload_mode, args.payload_seed, args.payload_file);
+    }
+    build_packets(packet_args);
+}
+
+/**
+ * Build the pool of packet slots for the packet size, DSCP and payload in the arguments.
+ */
+void build_packets(const struct arguments &args) {
+    raw_packet.reset();
+    stamp_crcs = args.crc && args.packet_size >= PAYLOAD_HEADER_BYTES + CRC_TRAILER_BYTES;
+    const size_t trailer_bytes{stamp_crcs ? CRC_TRAILER_BYTES : 0};
+    if (transport->needs_ip_headers()) {
+        raw_packet = std::make_unique<RawPacketTemplate>(out_addr.sin_addr.s_addr, args.dest_port,
+                                                         inet_addr(args.src_ip.c_str()), args.src_ip_count,
+                                                         args.src_port, args.src_port_count, args.packet_dscp,
+                                                         args.label_byte, args.packet_size, trailer_bytes);
+        slot_size = raw_packet->size();
+    } else {
+        slot_size = args.packet_size;
+    }
+    payload_offset = slot_size - args.packet_size;
+
+    free_buffer(packet_slots, packet_slots_count * packet_slots_size);
+    slot_count = std::max<uint32_t>(args.payload_pool, MAX_BATCH);
+    next_slot = 0;
+    packet_slots_size = slot_size;
+    packet_slots_count = slot_count;
+    packet_slots = (uint8_t *) allocate_buffer(slot_count * slot_size);
+    slot_body_crcs.assign(slot_count, 0);
+    slot_body_sums.assign(slot_count, 0);
+    const size_t body_size{args.packet_size - PAYLOAD_HEADER_BYTES - trailer_bytes};
+    for (uint32_t i = 0; i < slot_count; i++) {
+        uint8_t *slot{packet_slots + i * slot_size};
+        uint8_t *payload{slot + payload_offset};
+        if (raw_packet) {
+            raw_packet->copy_to(slot);
+        } else {
+            payload[0] = args.label_byte;
+        }
+        if (payload_source) {
+            payload_source->fill(payload + PAYLOAD_HEADER_BYTES, body_size, i);
+        }
+        if (stamp_crcs) {
+            slot_body_crcs[i] = body_crc(payload, args.packet_size);
+        }
+        if (raw_packet) {
+            slot_body_sums[i] = raw_packet->body_sum(slot);
+        }
+    }
+    for (auto &packet: batch) {
+        packet.length = slot_size;
+    }
+}
+
+void close_transport() {
+    if (queue_sampler) {
+        queue_sampler->stop();
+    }
+    transport.reset();
+    tcp_stream.reset();
+    raw_packet.reset();
+    free_buffer(packet_slots, packet_slots_count * packet_slots_size);
+    packet_slots = nullptr;
+    payload_source.reset();
+}
+
+/**
+ * Prefer allocating memory from the NUMA node of the interface packets leave through, and report if the sending thread
+ * was pinned to a CPU on another node.
+ * @return The interface's node, or -1 if unknown.
+ */
+static auto place_on_interface_node(const struct arguments &args) -> int {
+    const int node{args.interface.empty() ? -1 : interface_numa_node(args.interface)};
+    if (node < 0) {
+        return node;
+    }
+    prefer_numa_node(node);
+    if (args.verbose) {
+        std::cout << "Interface " << args.interface << " is on NUMA node " << node
+                  << ", allocating packet buffers there." << std::endl;
+    }
+    if (!args.cpus.empty()) {
+        const int cpu_node{cpu_numa_node(args.cpus[0])};
+        if (cpu_node >= 0 && cpu_node != node) {
+            std::cerr << "Sending thread is pinned to CPU " << args.cpus[0] << " on NUMA node " << cpu_node
+                      << ", but interface " << args.interface << " is on node " << node
+                      << ", every packet crosses the interconnect." << std::endl;
+        }
+    }
+    return node;
+}
+
+void enable_realtime(const struct arguments &args) {
+    // Before anything is allocated, so that buffers, trace rings and the event loop's thread follow the policy
+    const int numa_node{place_on_interface_node(args)};
+
+    // Buffers are only allocated after this, so they are locked and prefaulted as well
+    if (args.rt) {
+        use_huge_pages(true);
+        lock_memory();
+        if (args.verbose) {
+            std::cout << "Locked memory, allocating packet buffers from huge pages." << std::endl;
+        }
+    }
+    if (!args.trace.empty()) {
+        enable_tracing(args.trace_events);
+        trace_thread("sender");
+    }
+
+    // Signals and the control socket are served on their own thread, started before switching to SCHED_FIFO
+    event_loop = std::make_unique<EventLoop>();
+    // Registered after the globals were constructed, so it runs before they are destroyed on exit()
+    static const bool stops_at_exit{std::atexit(stop_event_loop) == 0};
+    (void) stops_at_exit;
+    register_handlers(*event_loop, [] {
+        if (control) {
+            control->interrupt();
+        }
+    });
+    if (!live_stats && (args.shm || !args.control.empty())) {
+        live_stats = std::make_unique<LiveStatsPublisher>(args.shm ? args.shm_name : "");
+    }
+    if (!args.control.empty()) {
+        control = std::make_unique<ControlServer>(
+                *event_loop, args.control,
+                RuntimeSettings{args.packet_freq, args.packet_size, args.packet_dscp, false}, live_stats->data());
+    }
+    if (args.queue_sample_ms > 0) {
+        const std::string interface{args.transport == TransportType::loopback ? "lo" : args.interface};
+        queue_sampler = std::make_unique<QueueSampler>(*event_loop, interface, args.queue_sample_ms);
+        queue_log = args.queue_log;
+    }
+    event_loop->start();
+
+    // Pin only the sending thread, the event loop keeps the full CPU set. The first of --cpus wins. Otherwise the thread
+    // is kept on the allowed CPUs of the interface's node, and under --rt on a single one of them, its current CPU if
+    // that is on the node, to rule out migrations. Without a known node, --rt pins to the current CPU.
+    std::vector<unsigned int> pinned_cpus;
+    if (!args.cpus.empty()) {
+        pinned_cpus = {args.cpus[0]};
+    } else if (numa_node >= 0) {
+        pinned_cpus = allowed_numa_node_cpus(numa_node);
+        if (pinned_cpus.empty()) {
+            std::cerr << "No CPU of NUMA node " << numa_node << " is allowed, interface " << args.interface
+                      << " is sent to from another node." << std::endl;
+        } else if (args.rt) {
+            const auto current{(unsigned int) sched_getcpu()};
+            const bool on_node{std::find(pinned_cpus.begin(), pinned_cpus.end(), current) != pinned_cpus.end()};
+            pinned_cpus = {on_node ? current : pinned_cpus[0]};
+        }
+    } else if (args.rt) {
+        pinned_cpus = {(unsigned int) sched_getcpu()};
+    }
+    if (!pinned_cpus.empty()) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (const unsigned int cpu: pinned_cpus) {
+            CPU_SET(cpu, &cpus);
+        }
+        const int error{pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus)};
+        if (error) {
+            errno = error;
+            perror("Can't pin sending thread");
+            exit(errno);
+        }
+        if (args.verbose && pinned_cpus.size() == 1) {
+            std::cout << "Pinned sending thread to CPU " << pinned_cpus[0] << "." << std::endl;
+        } else if (args.verbose) {
+            std::cout << "Pinned sending thread to the " << pinned_cpus.size() << " CPUs of NUMA node " << numa_node
+                      << "." << std::endl;
+        }
+    }
+
+    // Calibrated on the CPU the sending thread stays on
+    calibrate_clock();
+    if (args.verbose) {
+        std::cout << "Timestamping with " << clock_source_name() << "." << std::endl;
+    }
+
+    // Upgrade process to RT
+    if (geteuid() == 0) {
+        if (args.verbose) {
+            std::cout << "Running as root, switching to SCHED_FIFO scheduler.\n" << std::endl;
+        }
+        const struct sched_param schedParam = {sched_get_priority_max(SCHED_FIFO)};
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedParam) > 0) {
+            perror("Failed to change to SCHED_FIFO scheduler");
+            exit(errno);
+        }
+    } else if (args.verbose) {
+        std::cout << "Not running as root, using default scheduler.\n" << std::endl;
+    }
+}
+
+void publish_live_stats_in(LiveStatsSegment *segment) {
+    live_stats = std::make_unique<LiveStatsPublisher>(segment);
+}
+
+void halt_event_loop() {
+    if (event_loop) {
+        event_loop->stop();
+    }
+}
+
+void stop_event_loop() {
+    // Stop dispatching first, the objects below unwatch their descriptors as they are destroyed
+    if (event_loop) {
+        event_loop->stop();
+    }
+    control.reset();
+    queue_sampler.reset();
+    event_loop.reset();
+}
+
+auto interval_for(double packet_freq) -> int64_t {
+    return (int64_t) std::llround(S_TO_NS / packet_freq);
+}
+
+void record_send_times(int64_t *send_times, uint32_t capacity, uint32_t stride) {
+    send_times_ticks = send_times;
+    send_times_capacity = capacity;
+    send_times_stride = stride;
+}
+
+/**
+ * Reset the counters of a run and start what samples and publishes them.
+ * @return Performance counters at the start of the send loop.
+ */
+auto begin_run(const struct arguments &args) -> PerfSample {
+    packet_num = 0;
+    transport->reset_stats();
+    if (queue_sampler) {
+        queue_sampler->start(transport->queue_fd());
+    }
+
+    // Counters have to be opened on the sending thread
+    if (args.perf && !perf_counters) {
+        perf_counters = std::make_unique<PerfCounters>();
+    }
+    perf_phases.clear();
+    perf_phases.reserve(2);
+    if (live_stats) {
+        live_stats_period = (uint32_t) std::max(1.0, std::round(args.packet_freq / 1000));
+        live_stats_countdown = live_stats_period;
+        live_stats->start(args.packet_freq);
+    }
+    PerfSample loop_start{};
+    if (perf_counters) {
+        loop_start = perf_counters->read();
+    }
+    return loop_start;
+}
+
+/**
+ * Flush what a run left queued, stop sampling and publish its final counters.
+ * @param loop_start Performance counters at the start of the send loop.
+ */
+void end_run(const IntervalTimer &intervalTimer, const PerfSample &loop_start) {
+    PerfSample loop_end{};
+    if (perf_counters) {
+        loop_end = perf_counters->read();
+    }
+    transport->flush(flush_timeout_us);
+    if (queue_sampler) {
+        queue_sampler->stop();
+    }
+    if (perf_counters) {
+        perf_phases.push_back({"send loop", loop_start, loop_end});
+        perf_phases.push_back({"flush", loop_end, perf_counters->read()});
+    }
+    if (live_stats) {
+        live_stats->publish(packet_num, transport->stats(), intervalTimer.stats());
+        live_stats->finish();
+    }
+}
+
+auto run_generator(const struct arguments &args,
+                   IntervalTimer &intervalTimer) -> std::chrono::duration<double, std::micro> {
+    const PerfSample loop_start{begin_run(args)};
+    const SendLoop send_loop{select_send_loop(args, intervalTimer)};
+    intervalTimer.start();
+    const uint64_t elapsed_ticks{send_loop(intervalTimer, ns_to_ticks(args.timeout * S_TO_NS))};
+    end_run(intervalTimer, loop_start);
+    return std::chrono::duration<double, std::micro>{(double) ticks_to_ns(elapsed_ticks) / 1000};
+}
+
+/**
+ * Send replayed payloads and log them like generated packets.
+ */
+void send_replayed(const struct arguments &args, const OutgoingPacket *packets, uint32_t count) {
+    const uint32_t first_packet_num{packet_num + 1};
+    packet_num += count;
+
+    const int64_t send_start_ns{tracing() ? trace_now() : 0};
+    const uint64_t pre_send_ticks{clock_ticks()};
+    transport->send_batch(packets, count);
+    const uint64_t post_send_ticks{clock_ticks()};
+    trace_complete("send", send_start_ns, "packets", count);
+
+    if (!args.quiet) {
+        const int64_t log_start_ns{tracing() ? trace_now() : 0};
+        for (uint32_t my_packet_num = first_packet_num; my_packet_num != packet_num + 1; my_packet_num++) {
+            log_packet(std::cout, args.csv, my_packet_num, pre_send_ticks, post_send_ticks);
+        }
+        trace_complete("log", log_start_ns, "packets", count);
+    }
+}
+
+auto run_replay(const struct arguments &args,
+                IntervalTimer &intervalTimer) -> std::chrono::duration<double, std::micro> {
+    PcapReader reader{args.replay};
+    const PerfSample loop_start{begin_run(args)};
+
+    const uint64_t timeout_ticks{args.timeout ? ns_to_ticks(args.timeout * S_TO_NS) : UINT64_MAX};
+    RunStart start{};
+    uint64_t now_ticks{start.ticks};
+    intervalTimer.start();
+
+    // Payloads are sent straight out of the mapped capture
+    OutgoingPacket replayed[MAX_BATCH];
+    CapturedPacket captured{};
+    bool more{reader.next(captured)};
+    const int64_t first_timestamp_ns{captured.timestamp_ns};
+    while (more && !keyboard_interrupt && now_ticks - start.ticks < timeout_ticks) {
+        uint32_t due{1};
+        if (args.replay_fixed_rate) {
+            due = intervalTimer.await();
+        } else if (!intervalTimer.await_offset(
+                (int64_t) ((double) (captured.timestamp_ns - first_timestamp_ns) / args.replay_speed))) {
+            due = 0;
+        }
+        start.deadline_passed();
+        while (due > 0 && more) {
+            uint32_t count{0};
+            while (count < std::min<uint32_t>(due, MAX_BATCH) && more) {
+                replayed[count++] = {captured.payload, captured.length};
+                more = reader.next(captured);
+            }
+            send_replayed(args, replayed, count);
+            due -= count;
+        }
+        publish_counters(intervalTimer);
+        now_ticks = clock_ticks();
+        maybe_reanchor_clock(now_ticks);
+    }
+    end_run(intervalTimer, loop_start);
+    if (reader.skipped() > 0) {
+        std::cerr << "Skipped " << reader.skipped() << " captured packets that were not IPv4 UDP." << std::endl;
+    }
+    return std::chrono::duration<double, std::micro>{(double) ticks_to_ns(now_ticks - start.ticks) / 1000};
+}
+
+auto run_tcp_stream(const struct arguments &args) -> std::chrono::duration<double, std::micro> {
+    close_transport();
+    tcp_stream = std::make_unique<TcpStream>(args);
+    const uint64_t elapsed_ticks{tcp_stream->run(ns_to_ticks(args.timeout * S_TO_NS))};
+    return std::chrono::duration<double, std::micro>{(double) ticks_to_ns(elapsed_ticks) / 1000};
+}
+
+/**
+ * Send probe packets, which carry sequence number 0 and are not counted.
+ */
+void send_probes(uint32_t count) {
+    auto *const stamp{raw_packet ? (stamp_crcs ? stamp_next_slot<true, true> : stamp_next_slot<false, true>)
+                                 : (stamp_crcs ? stamp_next_slot<true, false> : stamp_next_slot<false, false>)};
+    while (count > 0) {
+        const uint32_t batch_size{std::min<uint32_t>(count, MAX_BATCH)};
+        for (uint32_t i = 0; i < batch_size; i++) {
+            batch[i].data = stamp(0);
+        }
+        transport->send_batch(batch, batch_size);
+        count -= batch_size;
+    }
+}
+
+auto run_warmup(const struct arguments &args, IntervalTimer &intervalTimer) -> WarmupStats {
+    WarmupStats res{};
+    LatenessHistogram lateness{};
+    const uint64_t limit_ticks{ns_to_ticks((int64_t) (args.warmup_s * S_TO_NS))};
+    const uint64_t window_ticks{std::max(warmup_window_ticks, (uint64_t) std::ceil(
+            args.packet_freq * (double) warmup_window_ns / S_TO_NS))};
+    size_t previous_bucket{0};
+    unsigned int agreeing_windows{0};
+
+    RunStart start{};
+    uint64_t now_ticks{start.ticks};
+    intervalTimer.start();
+    while (!keyboard_interrupt && now_ticks - start.ticks < limit_ticks && agreeing_windows < warmup_settled_windows) {
+        intervalTimer.reset_stats();
+        const PacerStats &window{intervalTimer.stats()};
+        while (!keyboard_interrupt && now_ticks - start.ticks < limit_ticks && window.ticks.load() < window_ticks) {
+            const uint32_t due{intervalTimer.await()};
+            start.deadline_passed();
+            if (due > 0 && args.warmup_probes) {
+                const int64_t probe_start_ns{tracing() ? trace_now() : 0};
+                send_probes(due);
+                trace_complete("probe", probe_start_ns, "packets", due);
+                res.probes += due;
+            }
+            now_ticks = clock_ticks();
+            maybe_reanchor_clock(now_ticks);
+        }
+
+        for (size_t bucket = 0; bucket < LatenessHistogram::BUCKETS; bucket++) {
+            lateness.merge(bucket, window.lateness.bucket_count(bucket));
+        }
+        lateness.merge_maximum(window.lateness.maximum());
+        res.max_ns = std::max(res.max_ns, window.lateness.maximum());
+        const uint64_t p99_ns{window.lateness.percentile(0.99)};
+        const size_t bucket{LatenessHistogram::bucket_of(p99_ns)};
+        if (res.windows == 0) {
+            res.first_p99_ns = p99_ns;
+        } else if (bucket <= previous_bucket + 1 && previous_bucket <= bucket + 1) {
+            agreeing_windows++;
+        } else {
+            agreeing_windows = 0;
+        }
+        previous_bucket = bucket;
+        res.last_p99_ns = p99_ns;
+        res.windows++;
+    }
+
+    res.duration = std::chrono::duration<double, std::micro>{(double) ticks_to_ns(now_ticks - start.ticks) / 1000};
+    res.settled = agreeing_windows >= warmup_settled_windows;
+    res.median_ns = lateness.percentile(0.5);
+    res.p99_ns = lateness.percentile(0.99);
+    transport->flush(flush_timeout_us);
+    intervalTimer.reset_stats();
+    return res;
+}
+
+void report_warmup(const WarmupStats &warmup) {
+    std::cout << "Warm-up ran for " << warmup.duration.count() / S_TO_US << " seconds";
+    if (warmup.probes) {
+        std::cout << " and sent " << warmup.probes << " probe packets";
+    }
+    std::cout << ". Lateness 99th percentile went from " << (double) warmup.first_p99_ns / 1000 << "us to "
+              << (double) warmup.last_p99_ns / 1000 << "us over " << warmup.windows << " windows and "
+              << (warmup.settled ? "settled." : "did not settle.") << std::endl << "Warm-up lateness: median "
+              << (double) warmup.median_ns / 1000 << "us, 99th percentile " << (double) warmup.p99_ns / 1000
+              << "us, max " << (double) warmup.max_ns / 1000 << "us." << std::endl << "Steady state:" << std::endl;
+}
+
+auto attempted_packets() -> uint32_t {
+    return packet_num;
+}
+
+auto send_stats() -> const SendStats & {
+    return transport->stats();
+}
@@ -0,0 +1,49 @@
+#include "histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+auto LatenessHistogram::bucket_of(uint64_t value_ns) -> size_t {
+    if (value_ns < 4) {
+        return value_ns;
+    }
+    const int msb{63 - __builtin_clzll(value_ns)};
+    return (size_t) (msb - 1) * 4 + ((value_ns >> (msb - 2)) & 3);
+}
+
+auto LatenessHistogram::bucket_upper_bound(size_t bucket) -> uint64_t {
+    if (bucket < 4) {
+        return bucket;
+    }
+    const size_t msb{bucket / 4 + 1};
+    const uint64_t lower{(uint64_t) (4 + bucket % 4) << (msb - 2)};
+    return lower + ((uint64_t) 1 << (msb - 2)) - 1;
+}
+
+void LatenessHistogram::reset() {
+    for (auto &count: counts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    total.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+auto LatenessHistogram::percentile(double fraction) const -> uint64_t {
+    uint64_t recorded{0};
+    for (const auto &count: counts) {
+        recorded += count.load(std::memory_order_relaxed);
+    }
+    if (recorded == 0) {
+        return 0;
+    }
+    const auto rank{(uint64_t) std::ceil(fraction * (double) recorded)};
+    uint64_t seen{0};
+    for (size_t bucket = 0; bucket < BUCKETS; bucket++) {
+        seen += counts[bucket].load(std::memory_order_relaxed);
+        if (seen >= rank && seen > 0) {
+            // Never report more than was recorded, a bucket's bound can lie past the maximum
+            return std::min(bucket_upper_bound(bucket), maximum());
+        }
+    }
+    return std::min(bucket_upper_bound(BUCKETS - 1), maximum());
+}
@@ -0,0 +1,255 @@
+#include "argparse.h"
+#include "constants.h"
+#include "live_stats.h"
+
+#include <cerrno> //errno
+#include <cstdio> //perror
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<double>::is_always_lock_free,
+              "Live statistics are shared between processes, which needs lock-free atomics");
+
+/**
+ * Store a value without any ordering, which compiles to a plain store.
+ */
+template<typename T, typename V>
+static inline void put(std::atomic<T> &field, V value) {
+    field.store((T) value, std::memory_order_relaxed);
+}
+
+template<typename T>
+static inline auto get(const std::atomic<T> &field) -> T {
+    return field.load(std::memory_order_relaxed);
+}
+
+static auto monotonic_ns() -> uint64_t {
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * S_TO_NS + now.tv_nsec;
+}
+
+auto read_live_stats(const LiveStatsSegment &segment) -> LiveStatsSnapshot {
+    LiveStatsSnapshot snapshot{};
+    while (true) {
+        const uint32_t sequence_before{segment.sequence.load(std::memory_order_acquire)};
+        if (sequence_before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        snapshot.pid = get(segment.pid);
+        snapshot.finished = get(segment.finished);
+        snapshot.start_ns = get(segment.start_ns);
+        snapshot.update_ns = get(segment.update_ns);
+        snapshot.target_rate = get(segment.target_rate);
+        snapshot.current_rate = get(segment.current_rate);
+        snapshot.attempted = get(segment.attempted);
+        snapshot.successful = get(segment.successful);
+        snapshot.dropped = get(segment.dropped);
+        snapshot.queued = get(segment.queued);
+        snapshot.missed_deadlines = get(segment.missed_deadlines);
+        snapshot.skipped_ticks = get(segment.skipped_ticks);
+        for (int error = 0; error <= MAX_COUNTED_ERRNO; error++) {
+            snapshot.errors[error] = get(segment.errors[error]);
+        }
+        snapshot.lateness_p50_ns = get(segment.lateness_p50_ns);
+        snapshot.lateness_p90_ns = get(segment.lateness_p90_ns);
+        snapshot.lateness_p99_ns = get(segment.lateness_p99_ns);
+        snapshot.lateness_p999_ns = get(segment.lateness_p999_ns);
+        snapshot.lateness_max_ns = get(segment.lateness_max_ns);
+        for (size_t bucket = 0; bucket < LatenessHistogram::BUCKETS; bucket++) {
+            snapshot.lateness_buckets[bucket] = get(segment.lateness_buckets[bucket]);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (segment.sequence.load(std::memory_order_relaxed) == sequence_before) {
+            return snapshot;
+        }
+    }
+}
+
+LiveStatsPublisher::LiveStatsPublisher(std::string name) : name(std::move(name)) {
+    void *memory;
+    if (this->name.empty()) {
+        memory = mmap(nullptr, sizeof(LiveStatsSegment), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    } else {
+        shm_unlink(this->name.c_str());
+        const int fd{shm_open(this->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644)};
+        if (fd < 0) {
+            perror("Can't create live statistics segment");
+            exit(errno);
+        }
+        if (ftruncate(fd, sizeof(LiveStatsSegment)) < 0) {
+            perror("Can't size live statistics segment");
+            exit(errno);
+        }
+        memory = mmap(nullptr, sizeof(LiveStatsSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    }
+    if (memory == MAP_FAILED) {
+        perror("Can't map live statistics segment");
+        exit(errno);
+    }
+
+    // The mapping starts zeroed, which is a valid state for every field
+    segment = (LiveStatsSegment *) memory;
+    put(segment->version, LIVE_STATS_VERSION);
+    put(segment->pid, getpid());
+    segment->magic.store(LIVE_STATS_MAGIC, std::memory_order_release);
+}
+
+LiveStatsPublisher::LiveStatsPublisher(LiveStatsSegment *segment) : segment(segment), owned(false) {
+    put(segment->version, LIVE_STATS_VERSION);
+    put(segment->pid, getpid());
+    segment->magic.store(LIVE_STATS_MAGIC, std::memory_order_release);
+}
+
+LiveStatsPublisher::~LiveStatsPublisher() {
+    if (!owned) {
+        return;
+    }
+    munmap(segment, sizeof(LiveStatsSegment));
+    if (!name.empty()) {
+        shm_unlink(name.c_str());
+    }
+}
+
+void LiveStatsPublisher::start(double target_rate) {
+    const uint32_t sequence{get(segment->sequence)};
+    put(segment->sequence, sequence + 1);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    last_attempted = 0;
+    last_update_ns = monotonic_ns();
+    put(segment->finished, 0);
+    put(segment->start_ns, last_update_ns);
+    put(segment->update_ns, last_update_ns);
+    put(segment->target_rate, target_rate);
+    put(segment->current_rate, 0);
+
+    segment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void LiveStatsPublisher::publish(uint64_t attempted, const SendStats &send_stats, const PacerStats &pacer_stats) {
+    const uint64_t now_ns{monotonic_ns()};
+    const uint32_t sequence{get(segment->sequence)};
+    put(segment->sequence, sequence + 1);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if (now_ns > last_update_ns) {
+        put(segment->current_rate, (double) (attempted - last_attempted) * S_TO_NS / (double) (now_ns - last_update_ns));
+    }
+    last_attempted = attempted;
+    last_update_ns = now_ns;
+    put(segment->update_ns, now_ns);
+    put(segment->attempted, attempted);
+    put(segment->successful, send_stats.successful);
+    put(segment->dropped, send_stats.dropped);
+    put(segment->queued, send_stats.queued);
+    put(segment->missed_deadlines, get(pacer_stats.missed_deadlines));
+    put(segment->skipped_ticks, get(pacer_stats.skipped_ticks));
+    for (int error = 0; error <= MAX_COUNTED_ERRNO; error++) {
+        put(segment->errors[error], send_stats.errors[error]);
+    }
+    const LatenessHistogram &lateness{pacer_stats.lateness};
+    put(segment->lateness_p50_ns, lateness.percentile(0.5));
+    put(segment->lateness_p90_ns, lateness.percentile(0.9));
+    put(segment->lateness_p99_ns, lateness.percentile(0.99));
+    put(segment->lateness_p999_ns, lateness.percentile(0.999));
+    put(segment->lateness_max_ns, lateness.maximum());
+    for (size_t bucket = 0; bucket < LatenessHistogram::BUCKETS; bucket++) {
+        put(segment->lateness_buckets[bucket], lateness.bucket_count(bucket));
+    }
+
+    segment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void LiveStatsPublisher::set_target_rate(double target_rate) {
+    const uint32_t sequence{get(segment->sequence)};
+    put(segment->sequence, sequence + 1);
+    std::atomic_thread_fence(std::memory_order_release);
+    put(segment->target_rate, target_rate);
+    segment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void LiveStatsPublisher::finish() {
+    const uint32_t sequence{get(segment->sequence)};
+    put(segment->sequence, sequence + 1);
+    std::atomic_thread_fence(std::memory_order_release);
+    put(segment->finished, 1);
+    segment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+auto default_live_stats_name(int pid) -> std::string {
+    return "/packet_generator." + std::to_string(pid);
+}
+
+auto attach_main(int argc, char *argv[]) -> int { // NOLINT(modernize-avoid-c-arrays) // Disabled as argv has to be of dynamic length
+    argparse::ArgumentParser parser("Packet Generator");
+    parser.add_description("Print the live statistics a generator started with --shm publishes.");
+    parser.add_argument("--attach").help("Pid of the generator, or the name it was given with --shm-name").required();
+    parser.add_argument("--interval").help("Time between samples in milliseconds").nargs(1).default_value(
+            (unsigned int) 1000).scan<'u', unsigned int>();
+    parser.add_argument("--count").help("Amount of samples to print. If omitted or 0, runs until the generator "
+                                        "finishes.").nargs(1).default_value((unsigned int) 0).scan<'u', unsigned int>();
+    try {
+        parser.parse_args(argc, argv);
+    } catch (const std::runtime_error &err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << parser;
+        std::exit(1);
+    }
+
+    std::string name{parser.get("--attach")};
+    if (name.find_first_not_of("0123456789") == std::string::npos) {
+        name = default_live_stats_name(std::stoi(name));
+    } else if (name[0] != '/') {
+        name.insert(0, "/");
+    }
+    const int fd{shm_open(name.c_str(), O_RDONLY, 0)};
+    if (fd < 0) {
+        perror("Can't open live statistics segment");
+        exit(errno);
+    }
+    void *memory{mmap(nullptr, sizeof(LiveStatsSegment), PROT_READ, MAP_SHARED, fd, 0)};
+    close(fd);
+    if (memory == MAP_FAILED) {
+        perror("Can't map live statistics segment");
+        exit(errno);
+    }
+    const auto &segment{*(const LiveStatsSegment *) memory};
+    if (segment.magic.load(std::memory_order_acquire) != LIVE_STATS_MAGIC ||
+        get(segment.version) != LIVE_STATS_VERSION) {
+        std::cerr << "Segment " << name << " is not a version " << LIVE_STATS_VERSION
+                  << " live statistics segment." << std::endl;
+        exit(1);
+    }
+
+    std::cout << std::fixed;
+    const unsigned int count{parser.get<unsigned int>("--count")};
+    for (unsigned int sample = 0; count == 0 || sample < count; sample++) {
+        if (sample > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(parser.get<unsigned int>("--interval")));
+        }
+        const LiveStatsSnapshot snapshot{read_live_stats(segment)};
+        uint64_t errors{0};
+        for (const uint64_t error_count: snapshot.errors) {
+            errors += error_count;
+        }
+        std::cout << "pid " << snapshot.pid << ": attempted " << snapshot.attempted << ", successful "
+                  << snapshot.successful << ", dropped " << snapshot.dropped << ", errors " << errors << ", rate "
+                  << snapshot.current_rate << "/" << snapshot.target_rate << "Hz, missed "
+                  << snapshot.missed_deadlines << ", lateness p50/p99/max " << (double) snapshot.lateness_p50_ns / 1000
+                  << "/" << (double) snapshot.lateness_p99_ns / 1000 << "/"
+                  << (double) snapshot.lateness_max_ns / 1000 << "us" << std::endl;
+        if (snapshot.finished) {
+            break;
+        }
+    }
+    munmap(memory, sizeof(LiveStatsSegment));
+    return 0;
+}
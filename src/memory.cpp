@@ -0,0 +1,87 @@
+#include "memory.h"
+
+#include <cerrno> //errno
+#include <cstdio> //perror
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <malloc.h>
+#include <sys/mman.h>
+
+// Stack the sending thread may use, faulted in up front
+const size_t prefaulted_stack_bytes{512 * 1024};
+
+bool huge_pages{false};
+
+void use_huge_pages(bool enabled) {
+    huge_pages = enabled;
+}
+
+/**
+ * @return Size a buffer is mapped with.
+ */
+static auto mapped_size(size_t size) -> size_t {
+    if (!huge_pages) {
+        return size;
+    }
+    return (size + HUGE_PAGE_BYTES - 1) / HUGE_PAGE_BYTES * HUGE_PAGE_BYTES;
+}
+
+auto allocate_buffer(size_t size) -> void * {
+    const size_t length{mapped_size(size)};
+    void *buffer{MAP_FAILED};
+    if (huge_pages) {
+        buffer = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE,
+                      -1, 0);
+    }
+    if (buffer == MAP_FAILED) {
+        buffer = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffer == MAP_FAILED) {
+            perror("Can't allocate buffer");
+            exit(errno);
+        }
+        // Without reserved huge pages, ask for transparent ones before the pages are faulted in
+        if (huge_pages) {
+            madvise(buffer, length, MADV_HUGEPAGE);
+        }
+        // Fault in every page only after the advice, so that they can be backed by huge pages
+        for (size_t offset = 0; offset < length; offset += 4096) {
+            ((volatile char *) buffer)[offset] = 0;
+        }
+    }
+    return buffer;
+}
+
+void free_buffer(void *buffer, size_t size) {
+    if (buffer != nullptr) {
+        munmap(buffer, mapped_size(size));
+    }
+}
+
+/**
+ * Touch the stack below the caller, so that deeper calls later on do not fault.
+ */
+static void prefault_stack() {
+    volatile char stack[prefaulted_stack_bytes];
+    for (size_t offset = 0; offset < prefaulted_stack_bytes; offset += 4096) {
+        stack[offset] = 0;
+    }
+    // Read back, so the writes can't be optimized away
+    (void) stack[0];
+}
+
+void lock_memory() {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+        perror("Can't lock memory, page faults may still delay packets");
+    }
+    // Keep freed memory in the process instead of unmapping it, and serve large allocations from the locked heap
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+    prefault_stack();
+
+    // The vDSO's clock data can't be locked, so map it in by reading each clock the generator uses once
+    timespec now{};
+    for (const clockid_t clock: {CLOCK_MONOTONIC, CLOCK_REALTIME, CLOCK_TAI}) {
+        clock_gettime(clock, &now);
+    }
+}
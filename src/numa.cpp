@@ -0,0 +1,82 @@
+#include "numa.h"
+
+#include <cerrno> //errno
+#include <climits>
+#include <cstdio> //perror
+#include <dirent.h>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * Read a sysfs list like "0-3,8-11".
+ */
+static auto read_cpu_list(const std::string &path) -> std::vector<unsigned int> {
+    std::vector<unsigned int> res;
+    std::ifstream file{path};
+    std::string range;
+    while (std::getline(file, range, ',')) {
+        unsigned int first;
+        unsigned int last;
+        const int fields{sscanf(range.c_str(), "%u-%u", &first, &last)};
+        if (fields < 1) {
+            continue;
+        }
+        for (unsigned int cpu = first; cpu <= (fields == 2 ? last : first); cpu++) {
+            res.push_back(cpu);
+        }
+    }
+    return res;
+}
+
+auto interface_numa_node(const std::string &interface) -> int {
+    // Virtual interfaces have no device, and devices of machines with a single node report -1
+    std::ifstream file{"/sys/class/net/" + interface + "/device/numa_node"};
+    int node{-1};
+    if (!(file >> node)) {
+        return -1;
+    }
+    return node;
+}
+
+auto cpu_numa_node(unsigned int cpu) -> int {
+    // The CPU's directory links to its node as nodeN
+    DIR *directory{opendir(("/sys/devices/system/cpu/cpu" + std::to_string(cpu)).c_str())};
+    if (directory == nullptr) {
+        return -1;
+    }
+    int res{-1};
+    while (const dirent *entry{readdir(directory)}) {
+        if (sscanf(entry->d_name, "node%d", &res) == 1) {
+            break;
+        }
+    }
+    closedir(directory);
+    return res;
+}
+
+auto allowed_numa_node_cpus(int node) -> std::vector<unsigned int> {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+        CPU_ZERO(&allowed);
+    }
+    std::vector<unsigned int> res;
+    for (const unsigned int cpu: read_cpu_list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")) {
+        if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+            res.push_back(cpu);
+        }
+    }
+    return res;
+}
+
+void prefer_numa_node(int node) {
+    const size_t bits_per_word{sizeof(unsigned long) * CHAR_BIT};
+    std::vector<unsigned long> nodes((size_t) node / bits_per_word + 1);
+    nodes[(size_t) node / bits_per_word] = 1UL << ((size_t) node % bits_per_word);
+    // The kernel reads one bit less than the maximum node it is given
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodes.data(), nodes.size() * bits_per_word + 1) < 0) {
+        perror("Can't place memory on the interface's NUMA node");
+    }
+}
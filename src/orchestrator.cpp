@@ -0,0 +1,247 @@
+#include "constants.h"
+#include "generator.h"
+#include "histogram.h"
+#include "live_stats.h"
+#include "orchestrator.h"
+
+#include <algorithm>
+#include <cerrno> //errno
+#include <csignal>
+#include <cstdio> //perror
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Time between combined reports while the instances run
+const timespec report_interval{1, 0};
+// Time between forking and the first departure, so that every instance is ready, in nanoseconds
+const int64_t start_delay_ns{100000000};
+// Exit status of an instance that was less than 95% successful, as report_stats exits with -95
+const int failed_check_status{(uint8_t) -95};
+
+/**
+ * Counters of all instances added up.
+ */
+struct CombinedStats {
+    uint64_t attempted{0};
+    uint64_t successful{0};
+    uint64_t dropped{0};
+    uint64_t queued{0};
+    uint64_t missed_deadlines{0};
+    uint64_t skipped_ticks{0};
+    uint64_t errors[MAX_COUNTED_ERRNO + 1]{};
+    double current_rate{0};
+    double target_rate{0};
+    uint64_t duration_ns{0};
+    uint64_t lateness_max_ns{0};
+    LatenessHistogram lateness{};
+};
+
+static auto instance_arguments(const struct arguments &args, unsigned int instance,
+                               int64_t grid_origin_ns) -> struct arguments {
+    struct arguments res{args};
+    res.instances = 1;
+    res.packet_freq = args.packet_freq / args.instances;
+    res.quiet = true;
+    res.src_port = args.src_port + instance * args.src_port_count;
+    if (!args.cpus.empty()) {
+        res.cpus = {args.cpus[instance % args.cpus.size()]};
+    }
+    if (!args.interfaces.empty()) {
+        res.interface = args.interfaces[instance % args.interfaces.size()];
+    }
+    if (!args.trace.empty()) {
+        res.trace = args.trace + "." + std::to_string(instance);
+    }
+    // Spread the instances evenly over the interval of a single instance
+    res.aligned = true;
+    res.start_at_ns = grid_origin_ns;
+    res.phase_offset_ns = args.phase_offset_ns + interval_for(res.packet_freq) * instance / args.instances;
+    return res;
+}
+
+static void combine(const LiveStatsSegment *segments, unsigned int instances, CombinedStats &combined) {
+    for (unsigned int instance = 0; instance < instances; instance++) {
+        const LiveStatsSnapshot snapshot{read_live_stats(segments[instance])};
+        combined.attempted += snapshot.attempted;
+        combined.successful += snapshot.successful;
+        combined.dropped += snapshot.dropped;
+        combined.queued += snapshot.queued;
+        combined.missed_deadlines += snapshot.missed_deadlines;
+        combined.skipped_ticks += snapshot.skipped_ticks;
+        for (int error = 0; error <= MAX_COUNTED_ERRNO; error++) {
+            combined.errors[error] += snapshot.errors[error];
+        }
+        combined.current_rate += snapshot.current_rate;
+        combined.target_rate += snapshot.target_rate;
+        combined.duration_ns = std::max(combined.duration_ns, snapshot.update_ns - snapshot.start_ns);
+        combined.lateness_max_ns = std::max(combined.lateness_max_ns, snapshot.lateness_max_ns);
+        for (size_t bucket = 0; bucket < LatenessHistogram::BUCKETS; bucket++) {
+            combined.lateness.merge(bucket, snapshot.lateness_buckets[bucket]);
+        }
+        combined.lateness.merge_maximum(snapshot.lateness_max_ns);
+    }
+}
+
+static void report_progress(const CombinedStats &combined, unsigned int running, unsigned int instances) {
+    std::cout << "Instances running " << running << "/" << instances << ": attempted " << combined.attempted
+              << ", successful " << combined.successful << ", rate " << combined.current_rate << "/"
+              << combined.target_rate << "Hz, missed " << combined.missed_deadlines << ", lateness p99 "
+              << (double) combined.lateness.percentile(0.99) / 1000 << "us." << std::endl;
+}
+
+/**
+ * Print the combined statistics like report_stats does for a single generator.
+ * @return Whether every instance passed the 95% check.
+ */
+static auto report_combined(const CombinedStats &combined, const std::vector<pid_t> &pids,
+                            const std::vector<int> &statuses) -> bool {
+    const double duration_s{(double) combined.duration_ns / S_TO_NS};
+    const double successful_percent{
+            combined.successful * 100.0 / (double) std::max<uint64_t>(combined.attempted + combined.skipped_ticks, 1)};
+    std::cout << "Ran " << pids.size() << " instances for " << duration_s << " seconds." << std::endl
+              << "Attempted to send " << combined.attempted << " packets, of which " << combined.successful << " ("
+              << successful_percent << "%) were successful." << std::endl << "Attempt frequency: "
+              << combined.attempted / duration_s << "Hz." << std::endl << "Successful attempt frequency: "
+              << combined.successful / duration_s << "Hz." << std::endl;
+    if (combined.dropped || combined.queued) {
+        std::cout << "Dropped " << combined.dropped << " packets, queued " << combined.queued << " for retrying."
+                  << std::endl;
+    }
+    for (int error = 0; error <= MAX_COUNTED_ERRNO; error++) {
+        if (combined.errors[error]) {
+            std::cout << "Failed send calls with errno " << error << " (" << strerror(error) << "): "
+                      << combined.errors[error] << "." << std::endl;
+        }
+    }
+    if (combined.missed_deadlines) {
+        std::cout << "Missed " << combined.missed_deadlines << " deadlines, skipped " << combined.skipped_ticks
+                  << " ticks." << std::endl;
+    }
+    std::cout << "Wakeup lateness: median " << (double) combined.lateness.percentile(0.5) / 1000
+              << "us, 99th percentile " << (double) combined.lateness.percentile(0.99) / 1000 << "us, max "
+              << (double) combined.lateness_max_ns / 1000 << "us." << std::endl;
+
+    bool passed{true};
+    for (size_t instance = 0; instance < pids.size(); instance++) {
+        const int status{statuses[instance]};
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            continue;
+        }
+        passed = false;
+        std::cerr << "Instance " << instance << " (pid " << pids[instance] << ") ";
+        if (WIFEXITED(status) && WEXITSTATUS(status) == failed_check_status) {
+            std::cerr << "was less than 95% successful." << std::endl;
+        } else if (WIFEXITED(status)) {
+            std::cerr << "exited with status " << WEXITSTATUS(status) << "." << std::endl;
+        } else {
+            std::cerr << "was killed by signal " << WTERMSIG(status) << "." << std::endl;
+        }
+    }
+    return passed && successful_percent >= 95;
+}
+
+auto run_orchestrator(const struct arguments &args, int (*run_instance)(const struct arguments &)) -> int {
+    const unsigned int instances{args.instances};
+    const size_t segments_size{sizeof(LiveStatsSegment) * instances};
+    auto *segments{(LiveStatsSegment *) mmap(nullptr, segments_size, PROT_READ | PROT_WRITE,
+                                             MAP_SHARED | MAP_ANONYMOUS, -1, 0)};
+    if (segments == MAP_FAILED) {
+        perror("Can't map instance statistics");
+        exit(errno);
+    }
+
+    // Signals are taken synchronously while waiting for the next report
+    sigset_t signals;
+    sigset_t original_signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &signals, &original_signals);
+
+    int64_t grid_origin_ns{args.start_at_ns};
+    if (!args.aligned) {
+        timespec now{};
+        clock_gettime(args.clock, &now);
+        grid_origin_ns = (int64_t) now.tv_sec * S_TO_NS + now.tv_nsec + start_delay_ns;
+    }
+
+    std::cout.flush();
+    std::vector<pid_t> pids(instances);
+    for (unsigned int instance = 0; instance < instances; instance++) {
+        const pid_t pid{fork()};
+        if (pid < 0) {
+            perror("Can't fork instance");
+            exit(errno);
+        }
+        if (pid == 0) {
+            sigprocmask(SIG_SETMASK, &original_signals, nullptr);
+            // The combined report replaces the instances' own output
+            const int null_fd{open("/dev/null", O_WRONLY)};
+            dup2(null_fd, STDOUT_FILENO);
+            close(null_fd);
+            publish_live_stats_in(&segments[instance]);
+            exit(run_instance(instance_arguments(args, instance, grid_origin_ns)));
+        }
+        pids[instance] = pid;
+    }
+
+    std::vector<int> statuses(instances, 0);
+    std::vector<bool> exited(instances, false);
+    unsigned int running{instances};
+    bool aborted{false};
+    while (running > 0) {
+        const int signal{sigtimedwait(&signals, nullptr, &report_interval)};
+        if (signal < 0 && errno == EAGAIN) {
+            CombinedStats combined{};
+            combine(segments, instances, combined);
+            report_progress(combined, running, instances);
+            continue;
+        }
+        if (signal == SIGINT || signal == SIGTERM) {
+            for (unsigned int instance = 0; instance < instances; instance++) {
+                if (!exited[instance]) {
+                    kill(pids[instance], SIGTERM);
+                }
+            }
+            continue;
+        }
+
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            const auto instance{(size_t) (std::find(pids.begin(), pids.end(), pid) - pids.begin())};
+            statuses[instance] = status;
+            exited[instance] = true;
+            running--;
+            if (aborted || (WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
+                continue;
+            }
+            // One failing instance spoils the aggregate, so stop the others
+            std::cerr << "Instance " << instance << " failed, aborting..." << std::endl;
+            aborted = true;
+            for (unsigned int other = 0; other < instances; other++) {
+                if (!exited[other]) {
+                    kill(pids[other], SIGTERM);
+                }
+            }
+        }
+    }
+
+    CombinedStats combined{};
+    combine(segments, instances, combined);
+    const bool passed{report_combined(combined, pids, statuses)};
+    munmap(segments, segments_size);
+    sigprocmask(SIG_SETMASK, &original_signals, nullptr);
+    if (!passed) {
+        std::cerr << "Less than 95% successful, aborting..." << std::endl;
+        exit(-95);
+    }
+    return 0;
+}
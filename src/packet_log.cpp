@@ -0,0 +1,14 @@
+#include "constants.h"
+#include "packet_log.h"
+#include "tsc_clock.h"
+
+void log_packet(std::ostream &out, bool csv, uint32_t packet_num, uint64_t pre_send_ticks, uint64_t post_send_ticks) {
+    // Wall time, truncated to whole microseconds
+    const double pre_send_s{double(ticks_to_realtime_ns(pre_send_ticks) / 1000) / S_TO_US};
+    const double post_send_s{double(ticks_to_realtime_ns(post_send_ticks) / 1000) / S_TO_US};
+    if (csv) {
+        out << packet_num << ", " << pre_send_s << ", " << post_send_s << std::endl;
+    } else {
+        out << "Sent packet " << packet_num << ": start " << pre_send_s << ", end " << post_send_s << std::endl;
+    }
+}
@@ -0,0 +1,100 @@
+#include "payload.h"
+
+#include <algorithm>
+#include <cerrno> //errno
+#include <cstdio> //perror
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+auto parse_payload_mode(const std::string &name) -> PayloadMode {
+    if (name == "zero") {
+        return PayloadMode::zero;
+    }
+    if (name == "random") {
+        return PayloadMode::random;
+    }
+    if (name == "pattern") {
+        return PayloadMode::pattern;
+    }
+    if (name == "file") {
+        return PayloadMode::file;
+    }
+    std::cerr << "Unknown payload mode " << name << ", expected zero, random, pattern or file." << std::endl;
+    exit(1);
+}
+
+/**
+ * Step a splitmix64 generator, which gives well-mixed output even from adjacent seeds.
+ */
+static auto splitmix64(uint64_t &state) -> uint64_t {
+    uint64_t value{state += 0x9e3779b97f4a7c15};
+    value = (value ^ value >> 30) * 0xbf58476d1ce4e5b9;
+    value = (value ^ value >> 27) * 0x94d049bb133111eb;
+    return value ^ value >> 31;
+}
+
+PayloadSource::PayloadSource(PayloadMode mode, uint64_t seed, const std::string &file) : mode(mode), seed(seed) {
+    if (mode != PayloadMode::file) {
+        return;
+    }
+    const int fd{open(file.c_str(), O_RDONLY)};
+    struct stat file_stat{};
+    if (fd < 0 || fstat(fd, &file_stat)) {
+        perror(("Can't open payload file " + file).c_str());
+        exit(errno);
+    }
+    file_size = (size_t) file_stat.st_size;
+    if (file_size == 0) {
+        std::cerr << "Payload file " << file << " is empty." << std::endl;
+        exit(1);
+    }
+    void *mapping{mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0)};
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        perror(("Can't map payload file " + file).c_str());
+        exit(errno);
+    }
+    file_data = (const uint8_t *) mapping;
+}
+
+PayloadSource::~PayloadSource() {
+    if (file_data != nullptr) {
+        munmap((void *) file_data, file_size);
+    }
+}
+
+void PayloadSource::fill(uint8_t *body, size_t length, uint32_t index) const {
+    switch (mode) {
+        case PayloadMode::zero:
+            std::memset(body, 0, length);
+            break;
+        case PayloadMode::random: {
+            uint64_t state{seed ^ (uint64_t) index << 32};
+            for (size_t i = 0; i < length; i += 8) {
+                const uint64_t value{splitmix64(state)};
+                std::memcpy(body + i, &value, std::min<size_t>(8, length - i));
+            }
+            break;
+        }
+        case PayloadMode::pattern:
+            for (size_t i = 0; i < length; i++) {
+                body[i] = (uint8_t) (index + i);
+            }
+            break;
+        case PayloadMode::file: {
+            // Every buffer continues where the previous one stopped, wrapping around at the end of the file
+            size_t offset{(size_t) index * length % file_size};
+            for (size_t i = 0; i < length;) {
+                const size_t chunk{std::min(length - i, file_size - offset)};
+                std::memcpy(body + i, file_data + offset, chunk);
+                i += chunk;
+                offset = 0;
+            }
+            break;
+        }
+    }
+}
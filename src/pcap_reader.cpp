@@ -0,0 +1,308 @@
+#include "constants.h"
+#include "pcap_reader.h"
+
+#include <algorithm>
+#include <cerrno> //errno
+#include <cstdio> //perror
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Bytes requested ahead of the cursor, and released behind it, at once
+const size_t read_ahead_bytes{16 * 1024 * 1024};
+
+const uint32_t pcap_magic_us{0xa1b2c3d4};
+const uint32_t pcap_magic_ns{0xa1b23c4d};
+const uint32_t pcapng_section_header{0x0a0d0d0a};
+const uint32_t pcapng_byte_order_magic{0x1a2b3c4d};
+const uint32_t pcapng_interface_description{1};
+const uint32_t pcapng_enhanced_packet{6};
+const uint16_t pcapng_option_tsresol{9};
+
+const size_t pcap_file_header_bytes{24};
+const size_t pcap_record_header_bytes{16};
+
+const uint32_t link_null{0};
+const uint32_t link_ethernet{1};
+const uint32_t link_raw{101};
+const uint32_t link_raw_bsd{12};
+const uint32_t link_loop{108};
+const uint32_t link_linux_sll{113};
+const uint32_t link_ipv4{228};
+const uint32_t link_linux_sll2{276};
+
+const uint16_t ether_type_ipv4{0x0800};
+const uint16_t ether_type_vlan{0x8100};
+const uint16_t ether_type_qinq{0x88a8};
+const uint8_t ip_protocol_udp{17};
+const size_t udp_header_bytes{8};
+
+static auto big_endian16(const uint8_t *at) -> uint16_t {
+    return (uint16_t) (at[0] << 8 | at[1]);
+}
+
+PcapReader::PcapReader(const std::string &path) {
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        perror(("Can't open " + path).c_str());
+        exit(errno);
+    }
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat)) {
+        perror(("Can't read " + path).c_str());
+        exit(errno);
+    }
+    size = (size_t) file_stat.st_size;
+    if (size < pcap_file_header_bytes) {
+        std::cerr << path << " is too short to be a capture." << std::endl;
+        exit(1);
+    }
+    void *mapping{mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)};
+    if (mapping == MAP_FAILED) {
+        perror(("Can't map " + path).c_str());
+        exit(errno);
+    }
+    data = (const uint8_t *) mapping;
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    uint32_t magic;
+    memcpy(&magic, data, sizeof(magic));
+    if (magic == pcapng_section_header) {
+        // The section header is parsed like any other block
+        pcapng = true;
+        return;
+    }
+    if (magic == pcap_magic_us || magic == pcap_magic_ns) {
+        swapped = false;
+    } else if (__builtin_bswap32(magic) == pcap_magic_us || __builtin_bswap32(magic) == pcap_magic_ns) {
+        swapped = true;
+        magic = __builtin_bswap32(magic);
+    } else {
+        std::cerr << path << " is neither a pcap nor a pcapng file." << std::endl;
+        exit(1);
+    }
+    interfaces.push_back({read32(20) & 0x0fffffff, (uint8_t) (magic == pcap_magic_ns ? 9 : 6), false});
+    offset = pcap_file_header_bytes;
+}
+
+PcapReader::~PcapReader() {
+    munmap((void *) data, size);
+    close(fd);
+}
+
+auto PcapReader::read16(size_t at) const -> uint16_t {
+    uint16_t value;
+    memcpy(&value, data + at, sizeof(value));
+    return swapped ? __builtin_bswap16(value) : value;
+}
+
+auto PcapReader::read32(size_t at) const -> uint32_t {
+    uint32_t value;
+    memcpy(&value, data + at, sizeof(value));
+    return swapped ? __builtin_bswap32(value) : value;
+}
+
+void PcapReader::advise() {
+    if (offset < advised_offset) {
+        return;
+    }
+    const size_t page_size{(size_t) sysconf(_SC_PAGESIZE)};
+    const size_t window_start{offset / page_size * page_size};
+    if (window_start >= read_ahead_bytes) {
+        // The pages behind the cursor are clean and can be dropped instead of pushing out other memory
+        const size_t released{window_start - read_ahead_bytes};
+        madvise((void *) data, released, MADV_DONTNEED);
+    }
+    madvise((void *) (data + window_start), std::min(read_ahead_bytes, size - window_start), MADV_WILLNEED);
+    advised_offset = window_start + read_ahead_bytes / 2;
+}
+
+auto PcapReader::to_ns(uint64_t timestamp, const Interface &interface) -> int64_t {
+    if (interface.binary_resolution) {
+        const uint64_t units{1ULL << interface.resolution};
+        return (int64_t) (timestamp / units * (uint64_t) S_TO_NS + timestamp % units * (uint64_t) S_TO_NS / units);
+    }
+    uint64_t units{1};
+    for (uint8_t i = 0; i < interface.resolution; i++) {
+        units *= 10;
+    }
+    if (units <= (uint64_t) S_TO_NS) {
+        return (int64_t) (timestamp * ((uint64_t) S_TO_NS / units));
+    }
+    return (int64_t) (timestamp / (units / (uint64_t) S_TO_NS));
+}
+
+auto PcapReader::udp_payload(uint32_t link_type, const uint8_t *frame, size_t length,
+                             CapturedPacket &packet) -> bool {
+    size_t ip_offset;
+    switch (link_type) {
+        case link_ethernet: {
+            size_t type_offset{12};
+            while (true) {
+                if (length < type_offset + 2) {
+                    return false;
+                }
+                const uint16_t ether_type{big_endian16(frame + type_offset)};
+                if (ether_type == ether_type_vlan || ether_type == ether_type_qinq) {
+                    type_offset += 4;
+                    continue;
+                }
+                if (ether_type != ether_type_ipv4) {
+                    return false;
+                }
+                break;
+            }
+            ip_offset = type_offset + 2;
+            break;
+        }
+        case link_raw:
+        case link_raw_bsd:
+        case link_ipv4:
+            ip_offset = 0;
+            break;
+        case link_linux_sll:
+            if (length < 16 || big_endian16(frame + 14) != ether_type_ipv4) {
+                return false;
+            }
+            ip_offset = 16;
+            break;
+        case link_linux_sll2:
+            if (length < 20 || big_endian16(frame) != ether_type_ipv4) {
+                return false;
+            }
+            ip_offset = 20;
+            break;
+        case link_null:
+        case link_loop:
+            // The address family is in host or network order, AF_INET is 2 everywhere
+            if (length < 4 || (frame[0] != 2 && frame[3] != 2)) {
+                return false;
+            }
+            ip_offset = 4;
+            break;
+        default:
+            return false;
+    }
+
+    if (length < ip_offset + 20) {
+        return false;
+    }
+    const uint8_t *ip{frame + ip_offset};
+    const size_t ip_header_bytes{(size_t) (ip[0] & 0x0f) * 4};
+    // Skip anything but IPv4 UDP, as well as fragments: only the first carries the UDP header
+    if (ip[0] >> 4 != 4 || ip_header_bytes < 20 || ip[9] != ip_protocol_udp || (big_endian16(ip + 6) & 0x3fff)) {
+        return false;
+    }
+    const size_t udp_offset{ip_offset + ip_header_bytes};
+    if (length < udp_offset + udp_header_bytes) {
+        return false;
+    }
+    const size_t udp_length{big_endian16(frame + udp_offset + 4)};
+    if (udp_length < udp_header_bytes) {
+        return false;
+    }
+    packet.payload = frame + udp_offset + udp_header_bytes;
+    // Captures may be cut short by their snap length
+    packet.length = std::min(udp_length - udp_header_bytes, length - udp_offset - udp_header_bytes);
+    return true;
+}
+
+auto PcapReader::next_pcapng_block(CapturedPacket &packet) -> bool {
+    if (size - offset < 12) {
+        offset = size;
+        return false;
+    }
+    uint32_t type;
+    memcpy(&type, data + offset, sizeof(type));
+    if (type == pcapng_section_header) {
+        uint32_t byte_order;
+        memcpy(&byte_order, data + offset + 8, sizeof(byte_order));
+        swapped = byte_order != pcapng_byte_order_magic;
+        // Interface numbers restart with every section
+        interfaces.clear();
+    } else {
+        type = read32(offset);
+    }
+    const size_t block_length{read32(offset + 4)};
+    if (block_length < 12 || block_length % 4 || block_length > size - offset) {
+        std::cerr << "Capture is corrupt at byte " << offset << ", stopping replay." << std::endl;
+        offset = size;
+        return false;
+    }
+    const size_t block{offset};
+    offset += block_length;
+
+    if (type == pcapng_interface_description && block_length >= 20) {
+        Interface interface{read16(block + 8), 6, false};
+        // Options follow the fixed fields, each padded to 4 bytes
+        size_t option{block + 16};
+        while (option + 4 <= block + block_length - 4) {
+            const uint16_t code{read16(option)};
+            const uint16_t option_length{read16(option + 2)};
+            if (code == 0) {
+                break;
+            }
+            if (code == pcapng_option_tsresol && option_length >= 1) {
+                interface.resolution = data[option + 4] & 0x7f;
+                interface.binary_resolution = data[option + 4] & 0x80;
+            }
+            option += 4 + (option_length + 3) / 4 * 4;
+        }
+        interfaces.push_back(interface);
+        return false;
+    }
+    if (type != pcapng_enhanced_packet || block_length < 32) {
+        return false;
+    }
+    const uint32_t interface_id{read32(block + 8)};
+    const size_t captured{read32(block + 20)};
+    if (interface_id >= interfaces.size() || captured > block_length - 32) {
+        skipped_packets++;
+        return false;
+    }
+    const Interface &interface{interfaces[interface_id]};
+    if (!udp_payload(interface.link_type, data + block + 28, captured, packet)) {
+        skipped_packets++;
+        return false;
+    }
+    const uint64_t timestamp{(uint64_t) read32(block + 12) << 32 | read32(block + 16)};
+    packet.timestamp_ns = to_ns(timestamp, interface);
+    return true;
+}
+
+auto PcapReader::next(CapturedPacket &packet) -> bool {
+    while (offset < size) {
+        advise();
+        if (pcapng) {
+            if (next_pcapng_block(packet)) {
+                return true;
+            }
+            continue;
+        }
+
+        if (size - offset < pcap_record_header_bytes) {
+            offset = size;
+            break;
+        }
+        const size_t record{offset};
+        const size_t captured{read32(record + 8)};
+        if (captured > size - record - pcap_record_header_bytes) {
+            // Truncated final record, as left behind by an interrupted capture
+            offset = size;
+            break;
+        }
+        offset += pcap_record_header_bytes + captured;
+        if (!udp_payload(interfaces[0].link_type, data + record + pcap_record_header_bytes, captured, packet)) {
+            skipped_packets++;
+            continue;
+        }
+        const int64_t fraction_ns{interfaces[0].resolution == 9 ? read32(record + 4) : read32(record + 4) * 1000LL};
+        packet.timestamp_ns = (int64_t) read32(record) * S_TO_NS + fraction_ns;
+        return true;
+    }
+    return false;
+}
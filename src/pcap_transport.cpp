@@ -0,0 +1,72 @@
+#include "transport.h"
+
+#include <algorithm>
+#include <cerrno> //errno
+#include <cstdlib>
+#include <ctime>
+
+// pcap file format, see https://www.tcpdump.org/manpages/pcap-savefile.5.txt
+const uint32_t pcap_magic_nanoseconds{0xA1B23C4D};
+const uint16_t pcap_version_major{2};
+const uint16_t pcap_version_minor{4};
+const uint32_t pcap_snaplen{65535};
+// Packets start with an IPv4 or IPv6 header
+const uint32_t linktype_raw{101};
+// Buffer file writes so the send loop only copies into memory
+const size_t pcap_buffer_size{1 << 20};
+
+struct pcap_file_header {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+};
+
+struct pcap_record_header {
+    uint32_t ts_sec;
+    uint32_t ts_nsec;
+    uint32_t incl_len;
+    uint32_t orig_len;
+};
+
+PcapTransport::PcapTransport(const std::string &path) {
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        perror("Can't open pcap file");
+        exit(errno);
+    }
+    setvbuf(file, nullptr, _IOFBF, pcap_buffer_size);
+
+    const pcap_file_header header{pcap_magic_nanoseconds, pcap_version_major, pcap_version_minor, 0, 0,
+                                  pcap_snaplen, linktype_raw};
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        perror("Can't write pcap header");
+        exit(errno);
+    }
+}
+
+PcapTransport::~PcapTransport() {
+    fclose(file);
+}
+
+void PcapTransport::send_batch(const OutgoingPacket *packets, size_t count) {
+    timespec now{};
+    clock_gettime(CLOCK_REALTIME, &now);
+    for (size_t i = 0; i < count; i++) {
+        const auto length{(uint32_t) packets[i].length};
+        const pcap_record_header header{(uint32_t) now.tv_sec, (uint32_t) now.tv_nsec, length, length};
+        if (fwrite(&header, sizeof(header), 1, file) != 1 || fwrite(packets[i].data, length, 1, file) != 1) {
+            send_stats.errors[std::min(errno, (int) MAX_COUNTED_ERRNO)]++;
+            send_stats.dropped++;
+            continue;
+        }
+        send_stats.successful++;
+    }
+}
+
+void PcapTransport::flush([[maybe_unused]] long timeout_us) {
+    fflush(file);
+}
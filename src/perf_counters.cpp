@@ -0,0 +1,120 @@
+#include "perf_counters.h"
+
+#include <cerrno> //errno
+#include <cstring>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * Type and config of each PerfEvent for perf_event_attr.
+ */
+const struct {
+    uint32_t type;
+    uint64_t config;
+} perf_event_types[PERF_EVENT_COUNT]{
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+static auto open_counter(uint32_t type, uint64_t config, bool exclude_kernel) -> int {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // Calling thread only, on any CPU
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+PerfCounters::PerfCounters() {
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        const auto &event_type{perf_event_types[event]};
+        fds[event] = open_counter(event_type.type, event_type.config, false);
+        // Counting in the kernel needs perf_event_paranoid <= 1 or CAP_PERFMON
+        if (fds[event] < 0 && (errno == EACCES || errno == EPERM)) {
+            fds[event] = open_counter(event_type.type, event_type.config, true);
+            user_only[event] = fds[event] >= 0;
+        }
+        if (fds[event] < 0) {
+            std::cout << "Performance counter " << name((PerfEvent) event) << " unavailable: " << strerror(errno)
+                      << "." << std::endl;
+        } else if (user_only[event]) {
+            std::cout << "Performance counter " << name((PerfEvent) event) << " only counts user space."
+                      << std::endl;
+        }
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (const int fd: fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+auto PerfCounters::read() const -> PerfSample {
+    PerfSample sample{};
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        if (fds[event] < 0) {
+            continue;
+        }
+        // Value, time enabled and time running
+        uint64_t data[3];
+        if (::read(fds[event], data, sizeof(data)) != sizeof(data)) {
+            continue;
+        }
+        sample.values[event] = data[2] && data[2] < data[1] ? (uint64_t) ((double) data[0] * data[1] / data[2])
+                                                            : data[0];
+    }
+    return sample;
+}
+
+auto PerfCounters::name(PerfEvent event) -> const char * {
+    switch (event) {
+        case PERF_CYCLES:
+            return "cycles";
+        case PERF_INSTRUCTIONS:
+            return "instructions";
+        case PERF_CACHE_MISSES:
+            return "cache misses";
+        case PERF_CONTEXT_SWITCHES:
+            return "context switches";
+        case PERF_PAGE_FAULTS:
+            return "page faults";
+        case PERF_EVENT_COUNT:
+            break;
+    }
+    return "unknown";
+}
+
+void report_perf_phases(const PerfCounters &counters, const std::vector<PerfPhase> &phases, uint64_t packets) {
+    if (packets == 0) {
+        return;
+    }
+    for (const auto &phase: phases) {
+        std::cout << "Per packet during " << phase.name << ":";
+        bool first{true};
+        for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+            if (!counters.available((PerfEvent) event)) {
+                continue;
+            }
+            const uint64_t delta{phase.end.values[event] - phase.start.values[event]};
+            std::cout << (first ? " " : ", ") << (double) delta / (double) packets << " "
+                      << PerfCounters::name((PerfEvent) event);
+            first = false;
+        }
+        if (first) {
+            std::cout << " no performance counters available";
+        }
+        std::cout << "." << std::endl;
+    }
+}
@@ -0,0 +1,332 @@
+#include "constants.h"
+#include "queue_sampler.h"
+
+#include <algorithm>
+#include <cerrno> //errno
+#include <cstdio> //perror
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <linux/gen_stats.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/pkt_sched.h>
+#include <linux/rtnetlink.h>
+#include <linux/sockios.h>
+#include <net/if.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// Amount of nanoseconds in a millisecond
+const int64_t ns_per_ms{1000000};
+// Fill level of the socket send buffer from which it counts as full
+const double socket_full_fraction{0.9};
+// Large enough for the qdiscs of a multi-queue interface in one read
+const size_t netlink_buffer_size{1 << 16};
+
+static auto monotonic_ns() -> int64_t {
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * S_TO_NS + now.tv_nsec;
+}
+
+/**
+ * Call a function for every attribute in a run of rtnetlink attributes.
+ * @param data First attribute.
+ * @param length Bytes of attributes.
+ * @param handle Called with the type, payload and payload length of each attribute.
+ */
+template<typename Handler>
+static void for_each_attribute(const uint8_t *data, size_t length, Handler handle) {
+    size_t offset{0};
+    while (offset + sizeof(rtattr) <= length) {
+        const auto *attribute{(const rtattr *) (data + offset)};
+        if (attribute->rta_len < sizeof(rtattr) || offset + attribute->rta_len > length) {
+            return;
+        }
+        handle(attribute->rta_type & NLA_TYPE_MASK, data + offset + RTA_LENGTH(0),
+               attribute->rta_len - RTA_LENGTH(0));
+        offset += RTA_ALIGN(attribute->rta_len);
+    }
+}
+
+/**
+ * Send an rtnetlink request and call a function for every message of the reply, until it is complete.
+ * @param fd Netlink socket.
+ * @param request Request, starting with its nlmsghdr.
+ * @param handle Called with every reply message that is not an error or the end of a dump.
+ * @return Whether the request succeeded.
+ */
+template<typename Handler>
+static auto netlink_query(int fd, const nlmsghdr &request, Handler handle) -> bool {
+    if (send(fd, &request, request.nlmsg_len, 0) < 0) {
+        return false;
+    }
+    static uint8_t buffer[netlink_buffer_size];
+    while (true) {
+        const ssize_t received{recv(fd, buffer, sizeof(buffer), 0)};
+        if (received < 0) {
+            return false;
+        }
+        size_t offset{0};
+        while (offset + sizeof(nlmsghdr) <= (size_t) received) {
+            const auto *header{(const nlmsghdr *) (buffer + offset)};
+            if (header->nlmsg_len < sizeof(nlmsghdr) || offset + header->nlmsg_len > (size_t) received) {
+                return false;
+            }
+            if (header->nlmsg_seq == request.nlmsg_seq) {
+                if (header->nlmsg_type == NLMSG_DONE) {
+                    return true;
+                }
+                if (header->nlmsg_type == NLMSG_ERROR) {
+                    return ((const nlmsgerr *) NLMSG_DATA(header))->error == 0;
+                }
+                handle(*header);
+                // Replies to requests without NLM_F_DUMP are a single message
+                if ((header->nlmsg_flags & NLM_F_MULTI) == 0) {
+                    return true;
+                }
+            }
+            offset += NLMSG_ALIGN(header->nlmsg_len);
+        }
+    }
+}
+
+QueueSampler::QueueSampler(EventLoop &loop, std::string interface, unsigned int period_ms) :
+        loop(loop), interface(std::move(interface)), period_ns((int64_t) period_ms * ns_per_ms) {
+    if (!this->interface.empty()) {
+        interface_index = (int) if_nametoindex(this->interface.c_str());
+        if (interface_index == 0) {
+            perror("Can't find interface to sample queues of");
+            exit(errno);
+        }
+        netlink_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+        if (netlink_fd < 0) {
+            perror("Can't open rtnetlink socket");
+            exit(errno);
+        }
+    }
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0) {
+        perror("Can't create queue sampling timer");
+        exit(errno);
+    }
+    const timespec period{period_ns / S_TO_NS, period_ns % S_TO_NS};
+    const itimerspec schedule{period, period};
+    if (timerfd_settime(timer_fd, 0, &schedule, nullptr) < 0) {
+        perror("Can't arm queue sampling timer");
+        exit(errno);
+    }
+    loop.watch(timer_fd, EPOLLIN, [this](uint32_t) {
+        uint64_t expirations;
+        if (read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+            sample();
+        }
+    });
+}
+
+QueueSampler::~QueueSampler() {
+    loop.unwatch(timer_fd);
+    close(timer_fd);
+    if (netlink_fd >= 0) {
+        close(netlink_fd);
+    }
+}
+
+void QueueSampler::start(int new_socket_fd) {
+    const std::lock_guard<std::mutex> lock{mutex};
+    samples.clear();
+    qdisc_kind.clear();
+    socket_fd = new_socket_fd;
+    socket_buffer_bytes = 0;
+    socklen_t option_length{sizeof(socket_buffer_bytes)};
+    if (socket_fd >= 0 && getsockopt(socket_fd, SOL_SOCKET, SO_SNDBUF, &socket_buffer_bytes, &option_length) < 0) {
+        perror("Can't read socket send buffer size");
+        exit(errno);
+    }
+    attempted.store(0, std::memory_order_relaxed);
+    successful.store(0, std::memory_order_relaxed);
+    start_ns = monotonic_ns();
+    sampling = true;
+}
+
+void QueueSampler::stop() {
+    const std::lock_guard<std::mutex> lock{mutex};
+    sampling = false;
+    socket_fd = -1;
+}
+
+void QueueSampler::sample() {
+    const std::lock_guard<std::mutex> lock{mutex};
+    if (!sampling) {
+        return;
+    }
+    QueueSample res{};
+    res.time_ns = monotonic_ns() - start_ns;
+    res.attempted = attempted.load(std::memory_order_relaxed);
+    res.successful = successful.load(std::memory_order_relaxed);
+    res.socket_queued_bytes = -1;
+    int queued{0};
+    if (socket_fd >= 0 && ioctl(socket_fd, SIOCOUTQ, &queued) == 0) {
+        res.socket_queued_bytes = queued;
+    }
+    if (netlink_fd >= 0) {
+        read_qdisc(res);
+        read_link(res);
+    }
+    samples.push_back(res);
+}
+
+void QueueSampler::read_qdisc(QueueSample &res) {
+    struct {
+        nlmsghdr header;
+        tcmsg message;
+    } request{};
+    request.header.nlmsg_len = sizeof(request);
+    request.header.nlmsg_type = RTM_GETQDISC;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = ++netlink_sequence;
+    request.message.tcm_family = AF_UNSPEC;
+    request.message.tcm_ifindex = interface_index;
+
+    netlink_query(netlink_fd, request.header, [&](const nlmsghdr &header) {
+        const auto *message{(const tcmsg *) NLMSG_DATA(&header)};
+        if (header.nlmsg_type != RTM_NEWQDISC || message->tcm_ifindex != interface_index ||
+            message->tcm_parent != TC_H_ROOT || header.nlmsg_len < NLMSG_ALIGN(NLMSG_LENGTH(sizeof(tcmsg)))) {
+            return;
+        }
+        // A multi-queue root such as mq reports the sum of the qdiscs of its transmit queues
+        const size_t offset{NLMSG_LENGTH(sizeof(tcmsg))};
+        for_each_attribute((const uint8_t *) &header + NLMSG_ALIGN(offset), header.nlmsg_len - NLMSG_ALIGN(offset),
+                           [&](uint16_t type, const uint8_t *payload, size_t length) {
+            if (type == TCA_KIND && qdisc_kind.empty()) {
+                qdisc_kind.assign((const char *) payload, strnlen((const char *) payload, length));
+            } else if (type == TCA_STATS2) {
+                for_each_attribute(payload, length, [&](uint16_t stats_type, const uint8_t *stats, size_t stats_length) {
+                    if (stats_type == TCA_STATS_QUEUE && stats_length >= sizeof(gnet_stats_queue)) {
+                        gnet_stats_queue queue{};
+                        memcpy(&queue, stats, sizeof(queue));
+                        res.qdisc_packets = queue.qlen;
+                        res.qdisc_backlog_bytes = queue.backlog;
+                        res.qdisc_drops = queue.drops;
+                        res.qdisc_requeues = queue.requeues;
+                        res.qdisc_overlimits = queue.overlimits;
+                    }
+                });
+            }
+        });
+    });
+}
+
+void QueueSampler::read_link(QueueSample &res) {
+    struct {
+        nlmsghdr header;
+        ifinfomsg message;
+    } request{};
+    request.header.nlmsg_len = sizeof(request);
+    request.header.nlmsg_type = RTM_GETLINK;
+    request.header.nlmsg_flags = NLM_F_REQUEST;
+    request.header.nlmsg_seq = ++netlink_sequence;
+    request.message.ifi_family = AF_UNSPEC;
+    request.message.ifi_index = interface_index;
+
+    netlink_query(netlink_fd, request.header, [&](const nlmsghdr &header) {
+        if (header.nlmsg_type != RTM_NEWLINK || header.nlmsg_len < NLMSG_ALIGN(NLMSG_LENGTH(sizeof(ifinfomsg)))) {
+            return;
+        }
+        const size_t offset{NLMSG_LENGTH(sizeof(ifinfomsg))};
+        for_each_attribute((const uint8_t *) &header + NLMSG_ALIGN(offset), header.nlmsg_len - NLMSG_ALIGN(offset),
+                           [&](uint16_t type, const uint8_t *payload, size_t length) {
+            if (type == IFLA_STATS64 && length >= sizeof(rtnl_link_stats64)) {
+                rtnl_link_stats64 stats{};
+                memcpy(&stats, payload, sizeof(stats));
+                res.driver_tx_dropped = stats.tx_dropped;
+                res.driver_tx_errors = stats.tx_errors;
+            }
+        });
+    });
+}
+
+void QueueSampler::summarise(std::ostream &out) {
+    const std::lock_guard<std::mutex> lock{mutex};
+    if (samples.size() < 2) {
+        out << "Too few queue samples to summarise, the run was shorter than two sampling periods." << std::endl;
+        return;
+    }
+    const QueueSample &first{samples.front()};
+    const QueueSample &last{samples.back()};
+    out << "Sampled queues " << samples.size() << " times, every " << (double) period_ns / ns_per_ms << "ms."
+        << std::endl;
+
+    if (last.socket_queued_bytes >= 0) {
+        std::vector<int64_t> queued;
+        queued.reserve(samples.size());
+        for (const auto &each: samples) {
+            queued.push_back(each.socket_queued_bytes);
+        }
+        std::sort(queued.begin(), queued.end());
+        out << "Socket send queue: median " << queued[queued.size() / 2] << "B, peak " << queued.back() << "B of "
+            << socket_buffer_bytes << "B SO_SNDBUF." << std::endl;
+    }
+    if (netlink_fd >= 0) {
+        uint32_t peak_packets{0};
+        uint32_t peak_bytes{0};
+        for (const auto &each: samples) {
+            peak_packets = std::max(peak_packets, each.qdisc_packets);
+            peak_bytes = std::max(peak_bytes, each.qdisc_backlog_bytes);
+        }
+        out << "Qdisc " << (qdisc_kind.empty() ? "unknown" : qdisc_kind) << " on " << interface << ": peak backlog "
+            << peak_packets << " packets in " << peak_bytes << "B, " << last.qdisc_drops - first.qdisc_drops
+            << " drops, " << last.qdisc_requeues - first.qdisc_requeues << " requeues, "
+            << last.qdisc_overlimits - first.qdisc_overlimits << " overlimits." << std::endl;
+        out << "Driver of " << interface << ": " << last.driver_tx_dropped - first.driver_tx_dropped
+            << " transmit drops, " << last.driver_tx_errors - first.driver_tx_errors << " transmit errors."
+            << std::endl;
+    }
+
+    // A sampling period is blamed on every queue that was full or dropping during it
+    const auto socket_full_bytes{(int64_t) (socket_full_fraction * socket_buffer_bytes)};
+    size_t failing{0};
+    size_t socket_full{0};
+    size_t qdisc_dropping{0};
+    size_t driver_dropping{0};
+    for (size_t i = 1; i < samples.size(); i++) {
+        const QueueSample &before{samples[i - 1]};
+        const QueueSample &after{samples[i]};
+        if (after.attempted - after.successful == before.attempted - before.successful) {
+            continue;
+        }
+        failing++;
+        socket_full += after.socket_queued_bytes >= 0 && socket_buffer_bytes > 0 &&
+                       std::max(before.socket_queued_bytes, after.socket_queued_bytes) >= socket_full_bytes;
+        qdisc_dropping += after.qdisc_drops > before.qdisc_drops;
+        driver_dropping += after.driver_tx_dropped > before.driver_tx_dropped;
+    }
+    if (failing > 0) {
+        out << "Sends failed in " << failing << " of " << samples.size() - 1 << " sampling periods. In those, the "
+            << "socket send queue was full in " << socket_full << ", the qdisc dropped in " << qdisc_dropping
+            << " and the driver dropped in " << driver_dropping << "." << std::endl;
+    }
+}
+
+void QueueSampler::write_log(const std::string &path) {
+    const std::lock_guard<std::mutex> lock{mutex};
+    std::ofstream log{path};
+    if (!log) {
+        perror("Can't open queue log");
+        exit(errno);
+    }
+    log << "time_ns,attempted,successful,socket_queued_bytes,qdisc_packets,qdisc_backlog_bytes,qdisc_drops,"
+           "qdisc_requeues,qdisc_overlimits,driver_tx_dropped,driver_tx_errors\n";
+    for (const auto &each: samples) {
+        log << each.time_ns << ',' << each.attempted << ',' << each.successful << ',' << each.socket_queued_bytes
+            << ',' << each.qdisc_packets << ',' << each.qdisc_backlog_bytes << ',' << each.qdisc_drops << ','
+            << each.qdisc_requeues << ',' << each.qdisc_overlimits << ',' << each.driver_tx_dropped << ','
+            << each.driver_tx_errors << '\n';
+    }
+}
@@ -0,0 +1,142 @@
+#include "checksum.h"
+#include "raw_packet.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno> //errno
+#include <cstdio> //perror
+#include <cstdlib>
+#include <cstring>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Payload bytes that change between packets: label, sequence number and one byte to stay word aligned
+const size_t variable_payload_bytes{6};
+
+RawPacketTemplate::RawPacketTemplate(in_addr_t dest_ip, uint16_t dest_port, in_addr_t src_ip, uint32_t src_ip_count,
+                                     uint16_t src_port, uint32_t src_port_count, uint8_t tos, uint8_t label_byte,
+                                     size_t payload_size, size_t trailer_bytes) :
+        length(sizeof(iphdr) + sizeof(udphdr) + payload_size), payload_size(payload_size),
+        // The trailer is summed from a word boundary, so that the body before it sums the same for every packet
+        trailer_start(trailer_bytes ? std::max(variable_payload_bytes, (payload_size - trailer_bytes) & ~(size_t) 1)
+                                    : payload_size),
+        first_src_ip(ntohl(src_ip)), first_src_port(src_port), src_ip_count(src_ip_count),
+        src_port_count(src_port_count) {
+    buffer = (uint8_t *) calloc(length, sizeof(uint8_t));
+    if (buffer == nullptr) {
+        perror("Can't calloc raw packet buffer");
+        exit(errno);
+    }
+
+    auto *ip_header = (iphdr *) buffer;
+    ip_header->version = 4;
+    ip_header->ihl = sizeof(iphdr) / 4;
+    ip_header->tos = tos;
+    ip_header->tot_len = htons((uint16_t) length);
+    ip_header->ttl = 64;
+    ip_header->protocol = IPPROTO_UDP;
+    ip_header->daddr = dest_ip;
+
+    auto *udp_header = (udphdr *) (buffer + sizeof(iphdr));
+    udp_header->dest = htons(dest_port);
+    udp_header->len = htons((uint16_t) (sizeof(udphdr) + payload_size));
+
+    uint8_t *payload{buffer + sizeof(iphdr) + sizeof(udphdr)};
+    payload[0] = label_byte;
+
+    // Source address, source port and both checksums are still zero, so they do not contribute
+    ip_base_sum = checksum_add(0, ip_header, sizeof(iphdr));
+
+    // UDP pseudo-header and UDP header, the payload body is summed per slot
+    const uint16_t pseudo_header[]{0, htons(IPPROTO_UDP), udp_header->len};
+    udp_base_sum = checksum_add(0, &dest_ip, sizeof(dest_ip));
+    udp_base_sum = checksum_add(udp_base_sum, pseudo_header, sizeof(pseudo_header));
+    udp_base_sum = checksum_add(udp_base_sum, udp_header, sizeof(udphdr));
+}
+
+RawPacketTemplate::~RawPacketTemplate() {
+    free(buffer);
+}
+
+void RawPacketTemplate::copy_to(void *slot) const {
+    std::memcpy(slot, buffer, length);
+}
+
+auto RawPacketTemplate::body_sum(const void *slot) const -> uint64_t {
+    const uint8_t *payload{(const uint8_t *) slot + sizeof(iphdr) + sizeof(udphdr)};
+    if (trailer_start <= variable_payload_bytes) {
+        return 0;
+    }
+    return checksum_add(0, payload + variable_payload_bytes, trailer_start - variable_payload_bytes);
+}
+
+void RawPacketTemplate::prepare(uint32_t packet_num, void *slot, uint64_t slot_body_sum) {
+    auto *ip_header = (iphdr *) slot;
+    auto *udp_header = (udphdr *) ((uint8_t *) slot + sizeof(iphdr));
+    uint8_t *payload{(uint8_t *) slot + sizeof(iphdr) + sizeof(udphdr)};
+
+    const uint32_t network_packet_num{htonl(packet_num)};
+    std::memcpy(&payload[1], &network_packet_num, 4);
+
+    const uint32_t src_ip{htonl(first_src_ip + src_ip_index)};
+    const uint16_t src_port{htons((uint16_t) (first_src_port + src_port_index))};
+    ip_header->saddr = src_ip;
+    udp_header->source = src_port;
+
+    // Rotate ports first, then addresses
+    if (++src_port_index == src_port_count) {
+        src_port_index = 0;
+        if (++src_ip_index == src_ip_count) {
+            src_ip_index = 0;
+        }
+    }
+
+    uint64_t ip_sum{ip_base_sum};
+    ip_sum = checksum_add(ip_sum, &src_ip, sizeof(src_ip));
+    ip_header->check = checksum_finish(ip_sum);
+
+    uint64_t udp_sum{udp_base_sum + slot_body_sum};
+    udp_sum = checksum_add(udp_sum, &src_ip, sizeof(src_ip));
+    udp_sum = checksum_add(udp_sum, &src_port, sizeof(src_port));
+    udp_sum = checksum_add(udp_sum, payload, std::min(payload_size, variable_payload_bytes));
+    if (trailer_start < payload_size) {
+        udp_sum = checksum_add(udp_sum, payload + trailer_start, payload_size - trailer_start);
+    }
+    const uint16_t udp_check{checksum_finish(udp_sum)};
+    // A zero checksum means "no checksum" for UDP over IPv4
+    udp_header->check = udp_check == 0 ? 0xFFFF : udp_check;
+}
+
+auto resolve_source_address(in_addr_t dest_ip, const std::string &interface) -> in_addr_t {
+    // Connecting a datagram socket selects a route without sending anything
+    const int probe_fd{socket(AF_INET, SOCK_DGRAM, 0)};
+    if (probe_fd < 0) {
+        perror("Can't open socket to resolve source address");
+        exit(errno);
+    }
+    if (!interface.empty() &&
+        setsockopt(probe_fd, SOL_SOCKET, SO_BINDTODEVICE, interface.c_str(), interface.length() + 1) < 0) {
+        perror("Can't bind to interface");
+        exit(errno);
+    }
+
+    sockaddr_in dest_addr{};
+    dest_addr.sin_family = AF_INET;
+    dest_addr.sin_addr.s_addr = dest_ip;
+    dest_addr.sin_port = htons(9);
+    if (connect(probe_fd, (sockaddr *) &dest_addr, sizeof(dest_addr)) < 0) {
+        perror("Can't find route to destination");
+        exit(errno);
+    }
+
+    sockaddr_in src_addr{};
+    socklen_t src_addr_len{sizeof(src_addr)};
+    if (getsockname(probe_fd, (sockaddr *) &src_addr, &src_addr_len) < 0) {
+        perror("Can't resolve source address");
+        exit(errno);
+    }
+    close(probe_fd);
+    return src_addr.sin_addr.s_addr;
+}
@@ -0,0 +1,120 @@
+#include "receiver.h"
+#include "trace.h"
+
+#include <arpa/inet.h>
+#include <cerrno> //errno
+#include <chrono>
+#include <cstdio> //perror
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Amount of packets to take from the socket per system call
+const unsigned int receive_batch{32};
+// Receive buffer to request, large enough to absorb scheduling hiccups at high rates
+const int receive_buffer_size{16 * 1024 * 1024};
+// How often the receiving thread checks whether it should stop, in milliseconds
+const int stop_poll_ms{10};
+
+Receiver::Receiver(unsigned int port, uint8_t label_byte, const std::string &interface) : label_byte(label_byte) {
+    socket_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (socket_fd < 0) {
+        perror("Can't open receiving socket");
+        exit(errno);
+    }
+    if (!interface.empty() &&
+        setsockopt(socket_fd, SOL_SOCKET, SO_BINDTODEVICE, interface.c_str(), interface.length() + 1) < 0) {
+        perror("Can't bind receiving socket to interface");
+        exit(errno);
+    }
+    // Forcing the size past rmem_max needs CAP_NET_ADMIN, fall back to what is allowed otherwise
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_RCVBUFFORCE, &receive_buffer_size, sizeof(receive_buffer_size)) < 0) {
+        setsockopt(socket_fd, SOL_SOCKET, SO_RCVBUF, &receive_buffer_size, sizeof(receive_buffer_size));
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(socket_fd, (sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("Can't bind receiving socket");
+        exit(errno);
+    }
+}
+
+Receiver::~Receiver() {
+    stop();
+    close(socket_fd);
+}
+
+void Receiver::start(int64_t *arrival_times, uint32_t capacity, uint32_t stride) {
+    stop();
+
+    // Throw away stragglers from earlier runs, truncating them to a single byte
+    uint8_t discard;
+    while (recv(socket_fd, &discard, sizeof(discard), MSG_TRUNC) >= 0) {}
+
+    arrival_times_ns = arrival_times;
+    arrival_times_capacity = capacity;
+    arrival_times_stride = stride;
+    received.store(0, std::memory_order_relaxed);
+    running.store(true, std::memory_order_release);
+    thread = std::thread(&Receiver::receive_loop, this);
+}
+
+void Receiver::stop() {
+    running.store(false, std::memory_order_release);
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void Receiver::receive_loop() {
+    // Only the label and sequence number are looked at, so the rest of each payload is truncated
+    uint8_t headers[receive_batch][5];
+    iovec iovecs[receive_batch];
+    mmsghdr messages[receive_batch];
+    for (unsigned int i = 0; i < receive_batch; i++) {
+        iovecs[i] = {headers[i], sizeof(headers[i])};
+        messages[i] = {};
+        messages[i].msg_hdr.msg_iov = &iovecs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    trace_thread("receiver");
+    pollfd poll_fd{socket_fd, POLLIN, 0};
+    uint64_t count{0};
+    while (running.load(std::memory_order_acquire)) {
+        if (poll(&poll_fd, 1, stop_poll_ms) <= 0) {
+            continue;
+        }
+        const int64_t receive_start_ns{tracing() ? trace_now() : 0};
+        const int amount{recvmmsg(socket_fd, messages, receive_batch, MSG_DONTWAIT, nullptr)};
+        if (amount <= 0) {
+            continue;
+        }
+        trace_complete("receive", receive_start_ns, "packets", (uint64_t) amount);
+        const int64_t arrival_ns{std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count()};
+
+        for (int i = 0; i < amount; i++) {
+            if (messages[i].msg_len < sizeof(headers[i]) || headers[i][0] != label_byte) {
+                continue;
+            }
+            count++;
+            if (arrival_times_ns != nullptr) {
+                uint32_t network_packet_num;
+                std::memcpy(&network_packet_num, &headers[i][1], 4);
+                const uint32_t packet_num{ntohl(network_packet_num)};
+                if (packet_num % arrival_times_stride == 0 &&
+                    packet_num / arrival_times_stride < arrival_times_capacity) {
+                    arrival_times_ns[packet_num / arrival_times_stride] = arrival_ns;
+                }
+            }
+        }
+        received.store(count, std::memory_order_release);
+    }
+}
@@ -0,0 +1,226 @@
+#include "constants.h"
+#include "memory.h"
+#include "send_path.h"
+
+#include <algorithm>
+#include <cerrno> //errno
+#include <cstdio> //perror
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+
+/**
+ * @return Whether an errno value means that the socket buffer or device queue is full.
+ */
+static auto is_backpressure(int error) -> bool {
+    return error == EAGAIN || error == EWOULDBLOCK || error == ENOBUFS;
+}
+
+static auto now_ns() -> int64_t {
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * S_TO_NS + now.tv_nsec;
+}
+
+/**
+ * Wait until the socket is writable or the deadline passes.
+ * @return Whether the socket became writable.
+ */
+static auto await_writable(int socket_fd, int64_t deadline_ns) -> bool {
+    const int64_t remaining_ns{std::max<int64_t>(deadline_ns - now_ns(), 0)};
+    const timespec timeout{remaining_ns / S_TO_NS, remaining_ns % S_TO_NS};
+    pollfd poll_fd{socket_fd, POLLOUT, 0};
+    return ppoll(&poll_fd, 1, &timeout, nullptr) > 0 && (poll_fd.revents & POLLOUT);
+}
+
+// First and longest pause between retries while the device queue is full, in nanoseconds
+const int64_t min_backoff_ns{2000};
+const int64_t max_backoff_ns{256000};
+
+/**
+ * Sleep for a retry pause, but not past the deadline, and double the pause for the next retry.
+ * Needed for ENOBUFS, which leaves POLLOUT set, so that polling would return at once.
+ * @return Whether the deadline is still ahead.
+ */
+static auto back_off(int64_t &backoff_ns, int64_t deadline_ns) -> bool {
+    const int64_t wake_ns{std::min(now_ns() + backoff_ns, deadline_ns)};
+    const timespec wake{wake_ns / S_TO_NS, wake_ns % S_TO_NS};
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr);
+    backoff_ns = std::min(backoff_ns * 2, max_backoff_ns);
+    return now_ns() < deadline_ns;
+}
+
+auto parse_backpressure_policy(const std::string &name) -> BackpressurePolicy {
+    if (name == "drop") {
+        return BackpressurePolicy::drop;
+    }
+    if (name == "queue") {
+        return BackpressurePolicy::queue;
+    }
+    if (name == "block") {
+        return BackpressurePolicy::block;
+    }
+    std::cerr << "Unknown backpressure policy " << name << ", expected drop, queue or block." << std::endl;
+    exit(1);
+}
+
+SendPath::SendPath(int socket_fd, const sockaddr_in &dest_addr, BackpressurePolicy policy, size_t queue_capacity,
+                   size_t max_packet_size, long block_deadline_us, size_t max_batch) :
+        socket_fd(socket_fd), dest_addr(dest_addr), policy(policy),
+        block_deadline{block_deadline_us / S_TO_US, (block_deadline_us % S_TO_US) * 1000},
+        queue_capacity(policy == BackpressurePolicy::queue ? queue_capacity : 0), max_packet_size(max_packet_size),
+        max_batch(max_batch) {
+    batch_messages = (mmsghdr *) calloc(max_batch, sizeof(mmsghdr));
+    batch_iovecs = (iovec *) calloc(max_batch, sizeof(iovec));
+    if (batch_messages == nullptr || batch_iovecs == nullptr) {
+        perror("Can't calloc batch headers");
+        exit(errno);
+    }
+    for (size_t i = 0; i < max_batch; i++) {
+        batch_messages[i].msg_hdr.msg_name = &this->dest_addr;
+        batch_messages[i].msg_hdr.msg_namelen = sizeof(this->dest_addr);
+        batch_messages[i].msg_hdr.msg_iov = &batch_iovecs[i];
+        batch_messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    if (this->queue_capacity > 0) {
+        queue_slots = (uint8_t *) allocate_buffer(this->queue_capacity * max_packet_size);
+        queue_lengths = (size_t *) allocate_buffer(this->queue_capacity * sizeof(size_t));
+    }
+}
+
+SendPath::~SendPath() {
+    free_buffer(queue_slots, queue_capacity * max_packet_size);
+    free_buffer(queue_lengths, queue_capacity * sizeof(size_t));
+    free(batch_messages);
+    free(batch_iovecs);
+}
+
+auto SendPath::try_send(const void *packet, size_t length) -> int {
+    if (sendto(socket_fd, packet, length, 0, (sockaddr *) &dest_addr, sizeof(dest_addr)) < 0) {
+        const int error{errno};
+        send_stats.errors[std::min(error, (int) MAX_COUNTED_ERRNO)]++;
+        return error;
+    }
+    send_stats.successful++;
+    return 0;
+}
+
+void SendPath::drain_queue() {
+    pollfd poll_fd{socket_fd, POLLOUT, 0};
+    if (poll(&poll_fd, 1, 0) <= 0 || !(poll_fd.revents & POLLOUT)) {
+        return;
+    }
+    while (queue_length > 0) {
+        const int error{try_send(queue_slots + queue_head * max_packet_size, queue_lengths[queue_head])};
+        if (is_backpressure(error)) {
+            return;
+        }
+        if (error) {
+            send_stats.dropped++;
+        }
+        queue_head = (queue_head + 1) % queue_capacity;
+        queue_length--;
+    }
+}
+
+void SendPath::enqueue(const void *packet, size_t length) {
+    if (queue_length == queue_capacity) {
+        send_stats.dropped++;
+        return;
+    }
+    const size_t tail{(queue_head + queue_length) % queue_capacity};
+    std::memcpy(queue_slots + tail * max_packet_size, packet, length);
+    queue_lengths[tail] = length;
+    queue_length++;
+    send_stats.queued++;
+}
+
+void SendPath::send_blocking(const void *packet, size_t length) {
+    const int64_t deadline_ns{now_ns() + block_deadline.tv_sec * S_TO_NS + block_deadline.tv_nsec};
+    int64_t backoff_ns{min_backoff_ns};
+    while (await_writable(socket_fd, deadline_ns)) {
+        const int error{try_send(packet, length)};
+        if (!is_backpressure(error)) {
+            if (error) {
+                send_stats.dropped++;
+            }
+            return;
+        }
+        // Polled writable but still refused, as with ENOBUFS
+        if (!back_off(backoff_ns, deadline_ns)) {
+            break;
+        }
+    }
+    send_stats.dropped++;
+}
+
+void SendPath::send(const void *packet, size_t length) {
+    // Keep packets in order: new packets wait behind queued ones
+    if (queue_length > 0) {
+        drain_queue();
+        if (queue_length > 0) {
+            enqueue(packet, length);
+            return;
+        }
+    }
+
+    const int error{try_send(packet, length)};
+    if (!error) {
+        return;
+    }
+    if (!is_backpressure(error)) {
+        send_stats.dropped++;
+        return;
+    }
+
+    switch (policy) {
+        case BackpressurePolicy::drop:
+            send_stats.dropped++;
+            break;
+        case BackpressurePolicy::queue:
+            enqueue(packet, length);
+            break;
+        case BackpressurePolicy::block:
+            send_blocking(packet, length);
+            break;
+    }
+}
+
+void SendPath::send_batch(const void *const *packets, const size_t *lengths, size_t count) {
+    size_t sent{0};
+    // Queued packets go first, which only the single packet path takes care of
+    if (queue_length == 0 && count > 1) {
+        for (size_t i = 0; i < count; i++) {
+            batch_iovecs[i] = {const_cast<void *>(packets[i]), lengths[i]};
+        }
+        const int result{sendmmsg(socket_fd, batch_messages, (unsigned int) count, 0)};
+        if (result > 0) {
+            sent = (size_t) result;
+            send_stats.successful += sent;
+        }
+    }
+    // Whatever was not accepted, including the packet that failed, gets the full single packet treatment
+    for (size_t i = sent; i < count; i++) {
+        send(packets[i], lengths[i]);
+    }
+}
+
+void SendPath::flush(long timeout_us) {
+    const int64_t deadline_ns{now_ns() + timeout_us * 1000};
+    int64_t backoff_ns{min_backoff_ns};
+    while (queue_length > 0 && await_writable(socket_fd, deadline_ns)) {
+        const size_t queued{queue_length};
+        drain_queue();
+        // Nothing went out although the socket is writable, so the device queue is full
+        if (queue_length == queued) {
+            back_off(backoff_ns, deadline_ns);
+        }
+        if (now_ns() >= deadline_ns) {
+            break;
+        }
+    }
+    send_stats.dropped += queue_length;
+    queue_length = 0;
+}
@@ -1,28 +1,53 @@
 #include "signal_handling.h"
 
+#include <cerrno> //errno
 #include <csignal>
-#include <cstdio>
+#include <cstdio> //perror
+#include <cstdlib>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
 #include <unistd.h>
 
-extern volatile uint32_t packet_num;
-volatile bool keyboard_interrupt{false};
+std::atomic<bool> keyboard_interrupt{false};
 
-void keyboard_interrupt_handler([[maybe_unused]]int signum) {
-    keyboard_interrupt = true;
-}
+/**
+ * Signal sent to the sending thread to break it out of a blocking wait.
+ */
+const int wakeup_signal{SIGUSR1};
+
+void wakeup_handler([[maybe_unused]]int signum) {}
 
-void missed_alarm_handler([[maybe_unused]]int signum) {
-    packet_num++;
-    if (write(1, "Missed alarm!\n", 14) < 0) {
-        perror("Failed to write to stdout");
+void register_handlers(EventLoop &loop, std::function<void()> on_interrupt) {
+    // Keyboard interrupts are only delivered through the signalfd
+    sigset_t interrupts;
+    sigemptyset(&interrupts);
+    sigaddset(&interrupts, SIGINT);
+    sigaddset(&interrupts, SIGTERM);
+    if (pthread_sigmask(SIG_BLOCK, &interrupts, nullptr) != 0) {
+        perror("Can't block keyboard interrupts");
+        exit(errno);
+    }
+    const int signal_fd{signalfd(-1, &interrupts, SFD_NONBLOCK | SFD_CLOEXEC)};
+    if (signal_fd < 0) {
+        perror("Can't open signalfd");
+        exit(errno);
     }
-}
 
-void register_handlers() {
-    // Handle keyboard interrupts
-    std::signal(SIGINT, keyboard_interrupt_handler);
-    std::signal(SIGTERM, keyboard_interrupt_handler);
+    // Without SA_RESTART, the wakeup signal makes clock_nanosleep and friends return EINTR
+    struct sigaction wakeup{};
+    wakeup.sa_handler = wakeup_handler;
+    sigemptyset(&wakeup.sa_mask);
+    sigaction(wakeup_signal, &wakeup, nullptr);
 
-    // Handle missed alarms
-    std::signal(SIGALRM, missed_alarm_handler);
+    const pthread_t sending_thread{pthread_self()};
+    loop.watch(signal_fd, EPOLLIN, [signal_fd, sending_thread, on_interrupt = std::move(on_interrupt)](uint32_t) {
+        signalfd_siginfo info{};
+        while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+            keyboard_interrupt = true;
+        }
+        if (on_interrupt) {
+            on_interrupt();
+        }
+        pthread_kill(sending_thread, wakeup_signal);
+    });
 }
@@ -0,0 +1,102 @@
+#include "transport.h"
+
+#include <algorithm>
+#include <cerrno> //errno
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/if_tun.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Frames appear to come from a locally administered address, so the device never sees its own address as source
+const uint8_t source_mac[6]{0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+const uint16_t ethertype_ipv4{0x0800};
+
+/**
+ * Set IFF_UP on a device if it isn't already.
+ * @param name Name of the device, as filled in by TUNSETIFF.
+ */
+static void bring_up(const char (&name)[IFNAMSIZ]) {
+    const int ioctl_fd{socket(AF_INET, SOCK_DGRAM, 0)};
+    if (ioctl_fd < 0) {
+        perror("Can't open socket to configure TAP device");
+        exit(errno);
+    }
+    ifreq request{};
+    memcpy(request.ifr_name, name, IFNAMSIZ);
+    if (ioctl(ioctl_fd, SIOCGIFFLAGS, &request) < 0) {
+        perror("Can't read TAP device flags");
+        exit(errno);
+    }
+    if ((request.ifr_flags & IFF_UP) == 0) {
+        request.ifr_flags |= IFF_UP;
+        if (ioctl(ioctl_fd, SIOCSIFFLAGS, &request) < 0) {
+            perror("Can't bring up TAP device");
+            exit(errno);
+        }
+    }
+    close(ioctl_fd);
+}
+
+TapTransport::TapTransport(const std::string &device) {
+    tap_fd = open("/dev/net/tun", O_RDWR | O_CLOEXEC);
+    if (tap_fd < 0) {
+        perror("Can't open /dev/net/tun");
+        exit(errno);
+    }
+
+    // Every process attaching with IFF_MULTI_QUEUE gets a queue of its own, so instances never share a lock. Devices
+    // made without multi_queue refuse the flag with EINVAL, a single instance can still attach to them without it.
+    ifreq request{};
+    request.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_MULTI_QUEUE;
+    device.copy(request.ifr_name, IFNAMSIZ - 1);
+    int result{ioctl(tap_fd, TUNSETIFF, &request)};
+    if (result < 0 && errno == EINVAL) {
+        request.ifr_flags = IFF_TAP | IFF_NO_PI;
+        result = ioctl(tap_fd, TUNSETIFF, &request);
+    }
+    if (result < 0 && errno == EBUSY) {
+        std::cerr << "TAP device " << device << " is in use, several instances need one made with multi_queue."
+                  << std::endl;
+        exit(EBUSY);
+    }
+    if (result < 0) {
+        perror("Can't attach to TAP device");
+        exit(errno);
+    }
+    if (ioctl(tap_fd, SIOCGIFHWADDR, &request) < 0) {
+        perror("Can't read TAP device address");
+        exit(errno);
+    }
+    bring_up(request.ifr_name);
+
+    memcpy(ethernet_header, request.ifr_hwaddr.sa_data, 6);
+    memcpy(ethernet_header + 6, source_mac, 6);
+    ethernet_header[12] = ethertype_ipv4 >> 8;
+    ethernet_header[13] = ethertype_ipv4 & 0xFF;
+}
+
+TapTransport::~TapTransport() {
+    close(tap_fd);
+}
+
+void TapTransport::send_batch(const OutgoingPacket *packets, size_t count) {
+    // A TAP device takes exactly one frame per write, the header is gathered in front of the packet without a copy
+    iovec frame[2]{{ethernet_header, sizeof(ethernet_header)}, {nullptr, 0}};
+    for (size_t i = 0; i < count; i++) {
+        frame[1].iov_base = const_cast<void *>(packets[i].data);
+        frame[1].iov_len = packets[i].length;
+        if (writev(tap_fd, frame, 2) < 0) {
+            send_stats.errors[std::min(errno, (int) MAX_COUNTED_ERRNO)]++;
+            send_stats.dropped++;
+            continue;
+        }
+        send_stats.successful++;
+    }
+}
@@ -0,0 +1,164 @@
+#include "arguments.h"
+#include "payload.h"
+#include "signal_handling.h"
+#include "tcp_stream.h"
+#include "tsc_clock.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno> //errno
+#include <csignal>
+#include <cstdio> //perror
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/sockios.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Size of the memfd sent when no file is given
+const size_t generated_file_bytes{16 * 1024 * 1024};
+// Most bytes handed to one sendfile() call
+const size_t sendfile_chunk_bytes{1024 * 1024};
+// Longest a send may block before the timeout is checked again
+const timeval send_block_timeout{0, 100000};
+
+/**
+ * Create a tmpfs-backed file holding the configured payload.
+ */
+static auto generate_file(const struct arguments &args) -> int {
+    const int fd{memfd_create("packet_generator", 0)};
+    if (fd < 0 || ftruncate(fd, (off_t) generated_file_bytes) < 0) {
+        perror("Can't create stream data file");
+        exit(errno);
+    }
+    if (args.payload_mode == PayloadMode::zero) {
+        return fd;
+    }
+    void *mapping{mmap(nullptr, generated_file_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)};
+    if (mapping == MAP_FAILED) {
+        perror("Can't map stream data file");
+        exit(errno);
+    }
+    const PayloadSource payload_source{args.payload_mode, args.payload_seed, args.payload_file};
+    payload_source.fill((uint8_t *) mapping, generated_file_bytes, 0);
+    munmap(mapping, generated_file_bytes);
+    return fd;
+}
+
+TcpStream::TcpStream(const struct arguments &args) {
+    if (args.tcp_file.empty()) {
+        file_fd = generate_file(args);
+        file_size = generated_file_bytes;
+    } else {
+        file_fd = open(args.tcp_file.c_str(), O_RDONLY);
+        struct stat file_stat{};
+        if (file_fd < 0 || fstat(file_fd, &file_stat) < 0) {
+            perror(("Can't open stream data file " + args.tcp_file).c_str());
+            exit(errno);
+        }
+        file_size = (size_t) file_stat.st_size;
+        if (file_size == 0) {
+            std::cerr << "Stream data file " << args.tcp_file << " is empty." << std::endl;
+            exit(1);
+        }
+    }
+
+    // sendfile() has no MSG_NOSIGNAL, a receiver that goes away has to show up as EPIPE instead
+    signal(SIGPIPE, SIG_IGN);
+    socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (socket_fd < 0) {
+        perror("Can't open TCP socket");
+        exit(errno);
+    }
+    if (!args.interface.empty() &&
+        setsockopt(socket_fd, SOL_SOCKET, SO_BINDTODEVICE, args.interface.c_str(), args.interface.length() + 1) < 0) {
+        perror("Can't bind to interface");
+        exit(errno);
+    }
+    const int tos{args.packet_dscp};
+    if (setsockopt(socket_fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) < 0) {
+        perror("Can't set DSCP");
+        exit(errno);
+    }
+    if (args.pacing_rate_mbps > 0) {
+        // The kernel takes the rate in bytes per second
+        const uint64_t pacing_rate{(uint64_t) (args.pacing_rate_mbps * S_TO_US / 8)};
+        if (setsockopt(socket_fd, SOL_SOCKET, SO_MAX_PACING_RATE, &pacing_rate, sizeof(pacing_rate)) < 0) {
+            perror("Can't set pacing rate");
+            exit(errno);
+        }
+    }
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_SNDTIMEO, &send_block_timeout, sizeof(send_block_timeout)) < 0) {
+        perror("Can't set send timeout");
+        exit(errno);
+    }
+
+    sockaddr_in dest_addr{};
+    dest_addr.sin_family = AF_INET;
+    dest_addr.sin_addr.s_addr = inet_addr(args.dest_ip.c_str());
+    dest_addr.sin_port = htons(args.dest_port);
+    if (connect(socket_fd, (sockaddr *) &dest_addr, sizeof(dest_addr)) < 0) {
+        perror("Can't connect to destination");
+        exit(errno);
+    }
+}
+
+TcpStream::~TcpStream() {
+    close(socket_fd);
+    close(file_fd);
+}
+
+auto TcpStream::run(uint64_t timeout_ticks) -> uint64_t {
+    bytes_sent = 0;
+    off_t offset{0};
+    const uint64_t start_ticks{clock_ticks()};
+    uint64_t now_ticks{start_ticks};
+    while (!keyboard_interrupt && (timeout_ticks == 0 || now_ticks - start_ticks < timeout_ticks)) {
+        if ((size_t) offset == file_size) {
+            offset = 0;
+        }
+        const ssize_t sent{sendfile(socket_fd, file_fd, &offset,
+                                    std::min(sendfile_chunk_bytes, file_size - (size_t) offset))};
+        if (sent > 0) {
+            bytes_sent += (uint64_t) sent;
+        } else if (sent == 0) {
+            // Only happens if the file shrank underneath us
+            offset = 0;
+        } else if (errno == EPIPE || errno == ECONNRESET) {
+            std::cerr << "Receiver closed the connection." << std::endl;
+            break;
+        } else if (errno != EINTR && errno != EAGAIN) {
+            perror("Failed to send");
+            exit(errno);
+        }
+        now_ticks = clock_ticks();
+        maybe_reanchor_clock(now_ticks);
+    }
+    return now_ticks - start_ticks;
+}
+
+auto TcpStream::stats() const -> TcpStreamStats {
+    TcpStreamStats res{};
+    res.bytes_sent = bytes_sent;
+    int unacked{0};
+    if (ioctl(socket_fd, SIOCOUTQ, &unacked) == 0) {
+        res.bytes_unacked = (uint64_t) unacked;
+    }
+    tcp_info info{};
+    socklen_t length{sizeof(info)};
+    if (getsockopt(socket_fd, IPPROTO_TCP, TCP_INFO, &info, &length) == 0) {
+        res.total_retransmits = info.tcpi_total_retrans;
+        res.rtt_us = info.tcpi_rtt;
+        res.rtt_var_us = info.tcpi_rttvar;
+        res.congestion_window = info.tcpi_snd_cwnd;
+        res.mss = info.tcpi_snd_mss;
+    }
+    return res;
+}
@@ -0,0 +1,102 @@
+#include "memory.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno> //errno
+#include <cstdint>
+#include <cstdio> //perror
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+thread_local TraceBuffer *thread_trace{nullptr};
+
+bool tracing_enabled{false};
+size_t trace_capacity{0};
+std::mutex trace_buffers_mutex;
+std::vector<std::unique_ptr<TraceBuffer>> trace_buffers;
+
+void enable_tracing(size_t capacity) {
+    tracing_enabled = true;
+    trace_capacity = capacity;
+}
+
+void trace_thread(const std::string &name) {
+    if (!tracing_enabled) {
+        return;
+    }
+    const std::lock_guard<std::mutex> lock{trace_buffers_mutex};
+    TraceBuffer *buffer{nullptr};
+    for (const auto &existing: trace_buffers) {
+        if (existing->thread_name == name) {
+            buffer = existing.get();
+        }
+    }
+    if (buffer == nullptr) {
+        trace_buffers.push_back(std::make_unique<TraceBuffer>(TraceBuffer{
+                name, 0, (TraceEvent *) allocate_buffer(trace_capacity * sizeof(TraceEvent)), trace_capacity, 0, 0}));
+        buffer = trace_buffers.back().get();
+    }
+    buffer->tid = (int32_t) syscall(SYS_gettid);
+    thread_trace = buffer;
+}
+
+/**
+ * Write a JSON number of microseconds from nanoseconds, keeping nanosecond precision.
+ */
+static void write_us(FILE *file, int64_t ns) {
+    fprintf(file, "%lld.%03lld", (long long) (ns / 1000), (long long) (ns % 1000));
+}
+
+void write_trace(const std::string &path) {
+    const std::lock_guard<std::mutex> lock{trace_buffers_mutex};
+    FILE *file{fopen(path.c_str(), "w")};
+    if (file == nullptr) {
+        perror("Can't open trace file");
+        exit(errno);
+    }
+    const int pid{getpid()};
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"packet_generator\"}}", pid);
+
+    // Timestamps start at the earliest event, to keep them short
+    int64_t origin_ns{INT64_MAX};
+    for (const auto &buffer: trace_buffers) {
+        if (buffer->count > 0) {
+            origin_ns = std::min(origin_ns, buffer->events[0].start_ns);
+        }
+    }
+    for (const auto &buffer: trace_buffers) {
+        int32_t named_tid{0};
+        for (size_t i = 0; i < buffer->count; i++) {
+            const TraceEvent &event{buffer->events[i]};
+            if (event.tid != named_tid) {
+                fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                        pid, event.tid, buffer->thread_name.c_str());
+                named_tid = event.tid;
+            }
+            fprintf(file, ",\n{\"name\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":", event.name, pid, event.tid);
+            write_us(file, event.start_ns - origin_ns);
+            if (event.duration_ns < 0) {
+                fprintf(file, ",\"ph\":\"i\",\"s\":\"t\"");
+            } else {
+                fprintf(file, ",\"ph\":\"X\",\"dur\":");
+                write_us(file, event.duration_ns);
+            }
+            if (event.value_name != nullptr) {
+                fprintf(file, ",\"args\":{\"%s\":%llu}", event.value_name, (unsigned long long) event.value);
+            }
+            fprintf(file, "}");
+        }
+        if (buffer->dropped) {
+            std::cerr << "Trace buffer of the " << buffer->thread_name << " thread was full, dropped "
+                      << buffer->dropped << " events." << std::endl;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+}
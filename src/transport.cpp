@@ -0,0 +1,120 @@
+#include "arguments.h"
+#include "transport.h"
+
+#ifdef PACKET_GENERATOR_DPDK
+#include "dpdk_transport.h"
+#endif
+
+#include <cerrno> //errno
+#include <cstdlib>
+#include <iostream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+auto parse_transport_type(const std::string &name) -> TransportType {
+    if (name == "socket") {
+        return TransportType::socket;
+    }
+    if (name == "null") {
+        return TransportType::null;
+    }
+    if (name == "loopback") {
+        return TransportType::loopback;
+    }
+    if (name == "pcap") {
+        return TransportType::pcap;
+    }
+    if (name == "tcp") {
+        return TransportType::tcp;
+    }
+    if (name == "tap") {
+        return TransportType::tap;
+    }
+    if (name == "dpdk") {
+        return TransportType::dpdk;
+    }
+    std::cerr << "Unknown transport " << name << ", expected socket, null, loopback, pcap, tcp, tap or dpdk."
+              << std::endl;
+    exit(1);
+}
+
+SocketTransport::SocketTransport(const struct arguments &args, const sockaddr_in &dest_addr,
+                                 size_t max_packet_size) : raw(args.raw) {
+    if (args.raw) {
+        socket_fd = socket(AF_INET, SOCK_RAW | SOCK_NONBLOCK, IPPROTO_RAW);
+    } else {
+        socket_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    }
+    if (socket_fd < 0) {
+        perror("Can't open socket");
+        exit(errno);
+    }
+
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_BINDTODEVICE, args.interface.c_str(), args.interface.length() + 1) <
+        0) {
+        perror("Can't bind to interface");
+        exit(errno);
+    }
+
+    set_tos(args.packet_dscp);
+
+    send_path = std::make_unique<SendPath>(socket_fd, dest_addr, args.backpressure, args.retry_queue_size,
+                                           max_packet_size, args.block_deadline_us, MAX_BATCH);
+}
+
+SocketTransport::~SocketTransport() {
+    send_path.reset();
+    close(socket_fd);
+}
+
+void SocketTransport::send_batch(const OutgoingPacket *packets, size_t count) {
+    if (count == 1) {
+        send_path->send(packets[0].data, packets[0].length);
+        return;
+    }
+    const void *data[MAX_BATCH];
+    size_t lengths[MAX_BATCH];
+    for (size_t i = 0; i < count; i++) {
+        data[i] = packets[i].data;
+        lengths[i] = packets[i].length;
+    }
+    send_path->send_batch(data, lengths, count);
+}
+
+void SocketTransport::flush(long timeout_us) {
+    send_path->flush(timeout_us);
+}
+
+void SocketTransport::set_tos(uint8_t tos) {
+    // With a raw socket, the ToS byte is part of the handcrafted IP header
+    if (!raw && setsockopt(socket_fd, SOL_IP, IP_TOS, &tos, 1) < 0) {
+        perror("Cant set ToS");
+        exit(errno);
+    }
+}
+
+auto make_transport(const struct arguments &args, const sockaddr_in &dest_addr,
+                    size_t max_packet_size) -> std::unique_ptr<Transport> {
+    switch (args.transport) {
+        case TransportType::null:
+            return std::make_unique<NullTransport>();
+        case TransportType::pcap:
+            return std::make_unique<PcapTransport>(args.pcap_file);
+        case TransportType::tap:
+            return std::make_unique<TapTransport>(args.interface);
+        case TransportType::socket:
+        case TransportType::loopback:
+            break;
+        case TransportType::dpdk:
+#ifdef PACKET_GENERATOR_DPDK
+            return std::make_unique<DpdkTransport>(args);
+#else
+            std::cerr << "This build has no DPDK support, build packet_generator_dpdk with make dpdk." << std::endl;
+            exit(1);
+#endif
+        case TransportType::tcp:
+            std::cerr << "TCP streams do not send packets and have no packet transport." << std::endl;
+            exit(1);
+    }
+    return std::make_unique<SocketTransport>(args, dest_addr, max_packet_size);
+}
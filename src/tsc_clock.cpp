@@ -0,0 +1,126 @@
+#include "tsc_clock.h"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+// Time between re-anchors
+const int64_t reanchor_period_ns{S_TO_NS};
+// Time to measure the tick rate over at startup
+const timespec calibration_period{0, 20000000};
+// Readings per sample, of which the one with the least time between its tick reads is kept
+const int sample_attempts{5};
+// Drift from CLOCK_MONOTONIC at a re-anchor beyond which the TSC is reported as unreliable
+const int64_t drift_warning_ns{100000};
+
+bool tsc_enabled{false};
+double ns_per_tick{1};
+uint64_t reanchor_at_ticks{0};
+
+/**
+ * Tick reading with the clock readings taken at the same moment.
+ */
+struct ClockSample {
+    uint64_t ticks;
+    int64_t monotonic_ns;
+    int64_t realtime_ns;
+};
+
+// Sample at calibration, which the tick rate is measured from, and the latest sample, which conversions start from
+ClockSample calibration_sample{};
+ClockSample anchor{};
+bool drift_reported{false};
+
+static auto to_ns(const timespec &time) -> int64_t {
+    return (int64_t) time.tv_sec * S_TO_NS + time.tv_nsec;
+}
+
+static auto take_sample() -> ClockSample {
+    ClockSample best{};
+    uint64_t best_width{UINT64_MAX};
+    for (int attempt = 0; attempt < sample_attempts; attempt++) {
+        timespec monotonic{};
+        timespec realtime{};
+        const uint64_t before{clock_ticks()};
+        clock_gettime(CLOCK_MONOTONIC, &monotonic);
+        clock_gettime(CLOCK_REALTIME, &realtime);
+        const uint64_t after{clock_ticks()};
+        if (after - before < best_width) {
+            best_width = after - before;
+            best = {before + (after - before) / 2, to_ns(monotonic), to_ns(realtime)};
+        }
+    }
+    return best;
+}
+
+/**
+ * @return Whether the CPU advertises an invariant TSC and the kernel still uses it as its clock source, which it
+ * stops doing once it catches the TSC misbehaving.
+ */
+static auto tsc_reliable() -> bool {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1U << 8))) {
+        return false;
+    }
+    std::ifstream clock_source{"/sys/devices/system/clocksource/clocksource0/current_clocksource"};
+    std::string name;
+    return clock_source >> name && name == "tsc";
+#else
+    return false;
+#endif
+}
+
+void calibrate_clock() {
+    tsc_enabled = tsc_reliable();
+    ns_per_tick = 1;
+    if (tsc_enabled) {
+        const ClockSample start{take_sample()};
+        nanosleep(&calibration_period, nullptr);
+        const ClockSample end{take_sample()};
+        ns_per_tick = (double) (end.monotonic_ns - start.monotonic_ns) / (double) (end.ticks - start.ticks);
+        // Anything outside 100MHz to 20GHz is a broken measurement, not a TSC
+        if (!std::isfinite(ns_per_tick) || ns_per_tick < 0.05 || ns_per_tick > 10) {
+            std::cerr << "TSC calibration failed, falling back to CLOCK_MONOTONIC." << std::endl;
+            tsc_enabled = false;
+            ns_per_tick = 1;
+        }
+    }
+    calibration_sample = take_sample();
+    anchor = calibration_sample;
+    drift_reported = false;
+    reanchor_at_ticks = anchor.ticks + ns_to_ticks(reanchor_period_ns);
+}
+
+void reanchor_clock() {
+    const ClockSample sample{take_sample()};
+    const uint64_t elapsed_ticks{sample.ticks - calibration_sample.ticks};
+    const int64_t drift_ns{sample.monotonic_ns - calibration_sample.monotonic_ns - ticks_to_ns(elapsed_ticks)};
+    if (!drift_reported && std::abs(drift_ns) > drift_warning_ns) {
+        std::cerr << "Warning: " << clock_source_name() << " drifted " << drift_ns / 1000
+                  << "us from CLOCK_MONOTONIC, timestamps may be off." << std::endl;
+        drift_reported = true;
+    }
+    // Measuring over everything since calibration keeps the error of single samples small
+    if (tsc_enabled && elapsed_ticks > 0) {
+        ns_per_tick = (double) (sample.monotonic_ns - calibration_sample.monotonic_ns) / (double) elapsed_ticks;
+    }
+    anchor = sample;
+    reanchor_at_ticks = anchor.ticks + ns_to_ticks(reanchor_period_ns);
+}
+
+auto clock_source_name() -> const char * {
+    return tsc_enabled ? "TSC" : "CLOCK_MONOTONIC";
+}
+
+auto ticks_to_realtime_ns(uint64_t ticks) -> int64_t {
+    // Ticks may lie before the anchor
+    const int64_t since_anchor_ns{ticks >= anchor.ticks ? ticks_to_ns(ticks - anchor.ticks)
+                                                        : -ticks_to_ns(anchor.ticks - ticks)};
+    return anchor.realtime_ns + since_anchor_ns;
+}
@@ -0,0 +1,219 @@
+#include "argparse.h"
+#include "constants.h"
+#include "payload.h"
+#include "verifier.h"
+
+#include <arpa/inet.h>
+#include <cerrno> //errno
+#include <chrono>
+#include <csignal>
+#include <cstdio> //perror
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+// Amount of packets to take from the socket per system call
+const unsigned int verify_batch{64};
+// Control message space per packet for its kernel receive timestamp
+const size_t timestamp_control_bytes{CMSG_SPACE(sizeof(timespec))};
+// Receive buffer to request, large enough to absorb scheduling hiccups at high rates
+const int verify_buffer_size{64 * 1024 * 1024};
+
+volatile sig_atomic_t verify_interrupted{0};
+
+static void stop_verifying(int) {
+    verify_interrupted = 1;
+}
+
+/**
+ * Counts kept while verifying.
+ */
+struct VerifyStats {
+    uint64_t received{0};
+    uint64_t crc_failed{0};
+    /**
+     * Packets too short to hold a CRC trailer.
+     */
+    uint64_t too_short{0};
+    /**
+     * Sequence numbers skipped over, which were lost unless they arrive out of order later.
+     */
+    uint64_t missing{0};
+    /**
+     * Packets whose sequence number was lower than one received before.
+     */
+    uint64_t out_of_order{0};
+};
+
+static void print_verify_stats(const char *prefix, const VerifyStats &stats, double rate) {
+    std::cout << prefix << "received " << stats.received << ", CRC failed " << stats.crc_failed << ", too short "
+              << stats.too_short << ", missing " << stats.missing << ", out of order " << stats.out_of_order
+              << ", rate " << rate << "Hz" << std::endl;
+}
+
+auto verify_main(int argc, char *argv[]) -> int { // NOLINT(modernize-avoid-c-arrays) // Disabled as argv has to be of dynamic length
+    argparse::ArgumentParser parser("Packet Generator");
+    parser.add_description("Receive packets sent with --crc and check their CRCs and sequence numbers.");
+    parser.add_argument("--verify").help("Port to receive on").required().scan<'u', unsigned int>();
+    parser.add_argument("-l", "--label").help("Only check packets with this label").nargs(1).default_value(
+            (uint8_t) 0).scan<'u', uint8_t>();
+    parser.add_argument("-i", "--interface").help("Interface to bind to").nargs(1).default_value((std::string) "");
+    parser.add_argument("--interval").help("Time between progress lines in milliseconds").nargs(1).default_value(
+            (unsigned int) 1000).scan<'u', unsigned int>();
+    parser.add_argument("-t", "--timeout").help("Stop after this many seconds. If omitted or 0, runs until "
+                                                "interrupted.").nargs(1).default_value((unsigned int) 0).scan<'u',
+            unsigned int>();
+    parser.add_argument("--arrivals").help(
+            "CSV file to log the label, sequence number and kernel receive time of every intact packet to, for "
+            "packet_generator --analyze").nargs(1).default_value((std::string) "");
+    try {
+        parser.parse_args(argc, argv);
+    } catch (const std::runtime_error &err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << parser;
+        std::exit(1);
+    }
+    const auto label_byte{parser.get<uint8_t>("--label")};
+    const std::string interface{parser.get("--interface")};
+    const std::chrono::milliseconds interval{parser.get<unsigned int>("--interval")};
+    const std::chrono::seconds timeout{parser.get<unsigned int>("--timeout")};
+    const std::string arrivals_path{parser.get("--arrivals")};
+
+    const int socket_fd{socket(AF_INET, SOCK_DGRAM, 0)};
+    if (socket_fd < 0) {
+        perror("Can't open receiving socket");
+        exit(errno);
+    }
+    if (!interface.empty() &&
+        setsockopt(socket_fd, SOL_SOCKET, SO_BINDTODEVICE, interface.c_str(), interface.length() + 1) < 0) {
+        perror("Can't bind receiving socket to interface");
+        exit(errno);
+    }
+    // Forcing the size past rmem_max needs CAP_NET_ADMIN, fall back to what is allowed otherwise
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_RCVBUFFORCE, &verify_buffer_size, sizeof(verify_buffer_size)) < 0) {
+        setsockopt(socket_fd, SOL_SOCKET, SO_RCVBUF, &verify_buffer_size, sizeof(verify_buffer_size));
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(parser.get<unsigned int>("--verify"));
+    if (bind(socket_fd, (sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("Can't bind receiving socket");
+        exit(errno);
+    }
+    std::ofstream arrivals_file;
+    if (!arrivals_path.empty()) {
+        // Stamped as the packet enters the stack, so that time spent waiting in the socket does not count as delay
+        const int enable{1};
+        if (setsockopt(socket_fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) < 0) {
+            perror("Can't enable receive timestamps");
+            exit(errno);
+        }
+        arrivals_file.open(arrivals_path);
+        if (!arrivals_file) {
+            perror("Can't open arrivals file");
+            exit(errno);
+        }
+        arrivals_file << "label, packet_num, arrival_s\n" << std::setfill('0');
+    }
+
+    // Without SA_RESTART, so that poll() returns to check the flag
+    struct sigaction action{};
+    action.sa_handler = stop_verifying;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    std::vector<uint8_t> buffers((size_t) verify_batch * MAX_UDP_PAYLOAD_BYTES);
+    iovec iovecs[verify_batch];
+    mmsghdr messages[verify_batch];
+    std::vector<uint8_t> controls(arrivals_path.empty() ? 0 : (size_t) verify_batch * timestamp_control_bytes);
+    for (unsigned int i = 0; i < verify_batch; i++) {
+        iovecs[i] = {&buffers[(size_t) i * MAX_UDP_PAYLOAD_BYTES], MAX_UDP_PAYLOAD_BYTES};
+        messages[i] = {};
+        messages[i].msg_hdr.msg_iov = &iovecs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    std::cout << std::fixed;
+    VerifyStats stats{};
+    uint64_t last_received{0};
+    uint32_t next_packet_num{1};
+    const auto start_time{std::chrono::steady_clock::now()};
+    auto next_report{start_time + interval};
+    pollfd poll_fd{socket_fd, POLLIN, 0};
+    while (!verify_interrupted && (timeout.count() == 0 || std::chrono::steady_clock::now() - start_time < timeout)) {
+        const auto now{std::chrono::steady_clock::now()};
+        if (now >= next_report) {
+            const double seconds{std::chrono::duration<double>(now - next_report + interval).count()};
+            print_verify_stats("", stats, (double) (stats.received - last_received) / seconds);
+            last_received = stats.received;
+            next_report = now + interval;
+        }
+        const auto wait_ms{std::chrono::duration_cast<std::chrono::milliseconds>(next_report - now).count()};
+        if (poll(&poll_fd, 1, (int) wait_ms + 1) <= 0) {
+            continue;
+        }
+        if (!controls.empty()) {
+            // The kernel shrinks the control length to what it filled in
+            for (unsigned int i = 0; i < verify_batch; i++) {
+                messages[i].msg_hdr.msg_control = &controls[(size_t) i * timestamp_control_bytes];
+                messages[i].msg_hdr.msg_controllen = timestamp_control_bytes;
+            }
+        }
+        const int amount{recvmmsg(socket_fd, messages, verify_batch, MSG_DONTWAIT, nullptr)};
+        for (int i = 0; i < amount; i++) {
+            const uint8_t *payload{(const uint8_t *) iovecs[i].iov_base};
+            const size_t length{messages[i].msg_len};
+            if (length < PAYLOAD_HEADER_BYTES || payload[0] != label_byte) {
+                continue;
+            }
+            if (length < PAYLOAD_HEADER_BYTES + CRC_TRAILER_BYTES) {
+                stats.too_short++;
+            } else if (!check_crc(payload, length)) {
+                // The sequence number can't be trusted either, so it can't be told apart from a probe
+                stats.received++;
+                stats.crc_failed++;
+                continue;
+            }
+
+            uint32_t network_packet_num;
+            std::memcpy(&network_packet_num, payload + 1, 4);
+            const uint32_t packet_num{ntohl(network_packet_num)};
+            // Warm-up probes carry sequence number 0, and count neither as received nor towards the rate
+            if (packet_num == 0) {
+                continue;
+            }
+            stats.received++;
+            if (packet_num >= next_packet_num) {
+                stats.missing += packet_num - next_packet_num;
+                next_packet_num = packet_num + 1;
+            } else {
+                stats.out_of_order++;
+                if (stats.missing > 0) {
+                    stats.missing--;
+                }
+            }
+            if (arrivals_file.is_open()) {
+                const cmsghdr *control{CMSG_FIRSTHDR(&messages[i].msg_hdr)};
+                if (control != nullptr && control->cmsg_level == SOL_SOCKET && control->cmsg_type == SCM_TIMESTAMPNS) {
+                    timespec arrival{};
+                    std::memcpy(&arrival, CMSG_DATA(control), sizeof(arrival));
+                    arrivals_file << (unsigned int) label_byte << ", " << packet_num << ", " << arrival.tv_sec << '.'
+                                  << std::setw(9) << arrival.tv_nsec << '\n';
+                }
+            }
+        }
+    }
+    close(socket_fd);
+
+    const double seconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()};
+    print_verify_stats("Total: ", stats, (double) stats.received / seconds);
+    return stats.crc_failed || stats.too_short ? 1 : 0;
+}